@@ -165,6 +165,7 @@ extern "C" {
 // Basic parameters for double scalar multiplication
 #define WP_DOUBLEBASE     8                            // Memory requirement: 24KB (storage for 256 points).
 #define WQ_DOUBLEBASE     4  
+#define WQ_CACHEDBASE     8                            // Memory requirement: 24KB per table generated by ecc_precomp_cached() (storage for 256 points).
    
 
 // FourQ's basic element definitions and point representations
@@ -35,9 +35,19 @@ bool ecc_mul(point_t P, digit_t* k, point_t Q, bool clear_cofactor);
 // Fixed-base scalar multiplication Q = k*G, where G is the generator
 bool ecc_mul_fixed(digit_t* k, point_t Q);
 
+// Batched fixed-base scalar multiplication Q[i] = k[i]*G, for i = 0,...,n-1
+bool ecc_mul_fixed_batch(digit_t* k, unsigned int n, point_t* Q);
+
 // Double scalar multiplication R = k*G + l*Q, where G is the generator
 bool ecc_mul_double(digit_t* k, point_t Q, digit_t* l, point_t R);
 
+// Multi-scalar multiplication Q = k[0]*P[0] + ... + k[n-1]*P[n-1]
+bool ecc_mul_multi(point_t* P, digit_t* k, unsigned int n, point_t Q);
+
+// Multi-scalar multiplication in caller-provided scratch memory of ecc_mul_multi_scratch_bytes(n) bytes, without allocating
+size_t ecc_mul_multi_scratch_bytes(unsigned int n);
+bool ecc_mul_multi_scratch(point_t* P, digit_t* k, unsigned int n, point_t Q, void* scratch, size_t bytes);
+
 
 /************* Public API for arithmetic functions modulo the curve order **************/
 
@@ -62,6 +72,12 @@ void subtract_mod_order(const digit_t* a, const digit_t* b, digit_t* c);
 // Reduction modulo the order using Montgomery arithmetic internally
 void modulo_order(digit_t* a, digit_t* c);
 
+// Sum modulo the order, c = terms[0]+...+terms[n-1] mod order, with n consecutive NWORDS_ORDER-digit terms and a single reduction
+void sum_mod_order(const digit_t* terms, unsigned int n, digit_t* c);
+
+// Sum of table entries modulo the order, c = sum of tables[k][indices[k*n+j]] for k < ntables, j < n, with a single reduction
+void sum_mod_order_gather(const digit_t* const* tables, const unsigned int* indices, unsigned int ntables, unsigned int n, digit_t* c);
+
 
 /**************** Public API for SchnorrQ ****************/
 
@@ -119,6 +135,12 @@ ECCRYPTO_STATUS CompressedSecretAgreement(const unsigned char* SecretKey, const
 // Output: 64-byte PublicKey
 ECCRYPTO_STATUS PublicKeyGeneration(const unsigned char* SecretKey, unsigned char* PublicKey);
 
+// Public key generation for n keys at once
+// It produces the public keys PublicKey[i] = SecretKey[i]*G, for i = 0,...,n-1, normalizing them together.
+// Input:  n 32-byte SecretKeys, stored consecutively
+// Output: n 64-byte PublicKeys, stored consecutively
+ECCRYPTO_STATUS PublicKeyGeneration_batch(const unsigned char* SecretKey, unsigned char* PublicKey, unsigned int n);
+
 // Keypair generation for key exchange
 // It produces a private key SecretKey and computes the public key PublicKey = SecretKey*G, where G is the generator.
 // Outputs: 32-byte SecretKey and 64-byte PublicKey 
@@ -65,6 +65,14 @@ extern "C" {
 // Basic parameters for double scalar multiplication
 #define NPOINTS_DOUBLEMUL_WP   (1 << (WP_DOUBLEBASE-2)) 
 #define NPOINTS_DOUBLEMUL_WQ   (1 << (WQ_DOUBLEBASE-2)) 
+#define NPOINTS_CACHED_WQ      (1 << (WQ_CACHEDBASE-2)) 
+#define NPOINTS_CACHED_TABLE   (4*NPOINTS_CACHED_WQ)   // Points in a table generated by ecc_precomp_cached()
+
+// Basic parameters for multi-scalar multiplication
+#define NPOINTS_FIXED_BATCH    32                      // Points ecc_mul_fixed_batch() normalizes with a single inversion
+#define NPOINTS_MULTI_CHUNK    16                      // Points interleaved at a time by ecc_mul_multi(). Stack requirement: ~3KB per point
+#define NPOINTS_MULTI_PIPPENGER 32                     // From this many points on, ecc_mul_multi() switches from Straus to Pippenger
+#define W_MULTI_PIPPENGER_MAX  14                      // Largest Pippenger window, 2^(W-1) buckets
    
 
 // FourQ's point representations        
@@ -311,6 +319,9 @@ void fp2inv1271(f2elm_t a);
 // Normalize projective twisted Edwards point Q = (X,Y,Z) -> P = (x,y)
 void eccnorm(point_extproj_t P, point_t Q);
 
+// Normalize n projective twisted Edwards points Q[i] = (X,Y,Z) -> P[i] = (x,y) using a single inversion
+void eccnorm_batch(point_extproj_t* P, point_t* Q, unsigned int n);
+
 // Conversion from representation (X,Y,Z,Ta,Tb) to (X+Y,Y-X,2Z,2dT), where T = Ta*Tb
 void R1_to_R2(point_extproj_t P, point_extproj_precomp_t Q);
 
@@ -370,6 +381,12 @@ const char* FourQ_get_error_message(ECCRYPTO_STATUS Status);
 // Mixed point addition P = P+Q or P = P+P
 void eccmadd_ni(point_precomp_t Q, point_extproj_t P);
 
+// Point conversion from affine coordinates (x,y) to representation (x+y,y-x,2dt)
+void point_setup_precomp(point_t P, point_precomp_t Q);
+
+// Conversion from representation (x+y,y-x,2dt) to (X,Y,Z,Ta,Tb)
+void R5_to_R1_ni(point_precomp_t P, point_extproj_t Q);
+
 // Constant-time table lookup to extract a point represented as (x+y,y-x,2t)
 void table_lookup_fixed_base(point_precomp_t* table, point_precomp_t P, unsigned int digit, unsigned int sign);
 
@@ -379,6 +396,17 @@ void mLSB_set_recode(uint64_t* scalar, unsigned int *digits);
 // Generation of the precomputation table used internally by the double scalar multiplication function ecc_mul_double()
 void ecc_precomp_double(point_extproj_t P, point_extproj_precomp_t* Table, unsigned int npoints);
 
+// Generation of a reusable precomputed table of NPOINTS_CACHED_TABLE points for the variable point of ecc_mul_double_cached()
+bool ecc_precomp_cached(point_t Q, point_precomp_t* Table);
+
+// Double scalar multiplication R = k*G + l*Q, where the table for Q was generated by ecc_precomp_cached()
+bool ecc_mul_double_cached(digit_t* k, point_precomp_t* Table, digit_t* l, point_t R);
+
+// Bucket (Pippenger) multi-scalar multiplication with a given window of c bits, in ecc_mul_multi_pippenger_bytes(n, c) bytes of scratch memory.
+// Only built with USE_ENDO; ecc_mul_multi_scratch() uses it with the window that suits n
+size_t ecc_mul_multi_pippenger_bytes(unsigned int n, unsigned int c);
+bool ecc_mul_multi_pippenger_scratch(point_t* P, digit_t* k, unsigned int n, unsigned int c, point_t Q, void* scratch);
+
 // Computes wNAF recoding of a scalar
 void wNAF_recode(uint64_t scalar, unsigned int w, int* digits);
 
@@ -143,6 +143,80 @@ void from_Montgomery(const digit_t* a, digit_t* mc)
 }
 
 
+static void reduce_wide_mod_order(const digit_t* a, digit_t* c)
+{ // Reduction modulo the order of an (NWORDS_ORDER+1)-digit value, c = a mod order
+  // With R = 2^(log_2(r)): a*R^(-1) = lo*R^(-1) + hi mod order, so one Montgomery multiplication by 1 and one by R^2 reduce a
+    digit_t one[NWORDS_ORDER] = {0}, high[NWORDS_ORDER] = {0};
+    one[0] = 1;
+    high[0] = a[NWORDS_ORDER];
+
+    Montgomery_multiply_mod_order(a, one, c);                              // c = lo*R^(-1) mod order, lo < 2^256
+    add_mod_order(c, high, c);                                             // c = a*R^(-1) mod order
+    Montgomery_multiply_mod_order(c, (digit_t*)&Montgomery_Rprime, c);     // c = a mod order
+}
+
+
+static __inline void accumulate_halves(uint64_t* acc, const digit_t* term)
+{ // Adds a term to 2*NWORDS_ORDER half-digit sums, acc[2i] += low half of term[i], acc[2i+1] += high half of term[i]
+  // There are no carries between the sums, so the additions are independent and vectorize
+    unsigned int i;
+
+    for (i = 0; i < NWORDS_ORDER; i++) {
+        acc[2*i] += (uint64_t)(term[i] & (((digit_t)1 << (RADIX/2)) - 1));
+        acc[2*i+1] += (uint64_t)(term[i] >> (RADIX/2));
+    }
+}
+
+
+static void reduce_halves_mod_order(const uint64_t* acc, digit_t* c)
+{ // Reduction modulo the order of the half-digit sums, c = sum of acc[k]*2^(k*RADIX/2) mod order
+    digit_t a[NWORDS_ORDER+1];
+    digit_t mask = ((digit_t)1 << (RADIX/2)) - 1;
+    uint64_t t, carry = 0;
+    unsigned int i;
+
+    for (i = 0; i < NWORDS_ORDER; i++) {               // Carry propagation into NWORDS_ORDER+1 digits
+        t = acc[2*i] + carry;
+        a[i] = (digit_t)t & mask;
+        carry = t >> (RADIX/2);
+        t = acc[2*i+1] + carry;
+        a[i] |= ((digit_t)t & mask) << (RADIX/2);
+        carry = t >> (RADIX/2);
+    }
+    a[NWORDS_ORDER] = (digit_t)carry;
+    reduce_wide_mod_order(a, c);
+}
+
+
+void sum_mod_order(const digit_t* terms, unsigned int n, digit_t* c)
+{ // Sum modulo the curve order, c = terms[0] + ... + terms[n-1] mod order, where each term takes NWORDS_ORDER digits
+  // Terms need not be reduced. The sum is accumulated in half-digit sums without carries and reduced once, so n must be less than 2^31
+    uint64_t acc[2*NWORDS_ORDER] = {0};
+    unsigned int j;
+
+    for (j = 0; j < n; j++) {
+        accumulate_halves(acc, terms + (size_t)j*NWORDS_ORDER);
+    }
+    reduce_halves_mod_order(acc, c);
+}
+
+
+void sum_mod_order_gather(const digit_t* const* tables, const unsigned int* indices, unsigned int ntables, unsigned int n, digit_t* c)
+{ // Sum of table entries modulo the curve order, c = sum over k < ntables and j < n of tables[k][indices[k*n + j]] mod order
+  // Each table entry takes NWORDS_ORDER digits. Same accumulation as sum_mod_order, so ntables*n must be less than 2^31
+  // SECURITY NOTE: the memory access pattern depends on the indices, which are assumed to be public.
+    uint64_t acc[2*NWORDS_ORDER] = {0};
+    unsigned int j, k;
+
+    for (k = 0; k < ntables; k++) {
+        for (j = 0; j < n; j++) {
+            accumulate_halves(acc, tables[k] + (size_t)indices[k*n + j]*NWORDS_ORDER);
+        }
+    }
+    reduce_halves_mod_order(acc, c);
+}
+
+
 void Montgomery_inversion_mod_order(const digit_t* ma, digit_t* mc)
 { // (Non-constant time) Montgomery inversion modulo the curve order using a^(-1) = a^(order-2) mod order
   // This function uses the sliding-window method
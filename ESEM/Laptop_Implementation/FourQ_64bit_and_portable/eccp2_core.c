@@ -14,6 +14,7 @@
 #include "FourQ_internal.h"
 #include "FourQ_params.h"
 #include "FourQ_tables.h"
+#include <stdlib.h>
 #if defined(GENERIC_IMPLEMENTATION)
     #include "generic/fp.h"
 #elif (TARGET == TARGET_AMD64)
@@ -176,6 +177,39 @@ void eccnorm(point_extproj_t P, point_t Q)
 }
 
 
+void eccnorm_batch(point_extproj_t* P, point_t* Q, unsigned int n)
+{ // Normalize n projective points using a single inversion (Montgomery's simultaneous inversion), including full reduction
+  // Input: P[i] = (X1:Y1:Z1) in twisted Edwards coordinates, for i = 0,...,n-1. Nothing is done when n = 0
+  // Output: Q[i] = (X1/Z1,Y1/Z1), corresponding to (X1:Y1:Z1:T1) in extended twisted Edwards coordinates
+  // The running products Z_0*...*Z_i are kept in Q[i]->x. P is not modified.
+    f2elm_t t1, t2;
+    unsigned int i;
+
+    if (n == 0) return;                                // Q[n-1] below would wrap around
+
+    fp2copy1271(P[0]->z, Q[0]->x);
+    for (i = 1; i < n; i++) {
+        fp2mul1271(Q[i-1]->x, P[i]->z, Q[i]->x);       // Q[i].x = Z_0*...*Z_i
+    }
+    fp2copy1271(Q[n-1]->x, t1);
+    fp2inv1271(t1);                                    // t1 = (Z_0*...*Z_n-1)^-1
+
+    for (i = n-1; i > 0; i--) {
+        fp2mul1271(t1, Q[i-1]->x, t2);                 // t2 = Z_i^-1
+        fp2mul1271(t1, P[i]->z, t1);                   // t1 = (Z_0*...*Z_i-1)^-1
+        fp2mul1271(P[i]->x, t2, Q[i]->x);              // X1 = X1/Z1
+        fp2mul1271(P[i]->y, t2, Q[i]->y);              // Y1 = Y1/Z1
+    }
+    fp2mul1271(P[0]->x, t1, Q[0]->x);
+    fp2mul1271(P[0]->y, t1, Q[0]->y);
+
+    for (i = 0; i < n; i++) {
+        mod1271(Q[i]->x[0]); mod1271(Q[i]->x[1]); 
+        mod1271(Q[i]->y[0]); mod1271(Q[i]->y[1]); 
+    }
+}
+
+
 __inline void R1_to_R2(point_extproj_t P, point_extproj_precomp_t Q) 
 { // Conversion from representation (X,Y,Z,Ta,Tb) to (X+Y,Y-X,2Z,2dT), where T = Ta*Tb
   // Input:  P = (X1,Y1,Z1,Ta,Tb), where T1 = Ta*Tb, corresponding to (X1:Y1:Z1:T1) in extended twisted Edwards coordinates
@@ -330,6 +364,19 @@ __inline bool ecc_point_validate(point_extproj_t P)
 }
 
 
+void point_setup_precomp(point_t P, point_precomp_t Q)
+{ // Point conversion to representation (x+y,y-x,2dt) 
+  // Input: P = (x,y) in affine coordinates
+  // Output: Q = (x+y,y-x,2dt), where t=x*y, corresponding to (X:Y:Z:T) in extended twisted Edwards coordinates, where Z=1
+
+    fp2add1271(P->x, P->y, Q->xy);                    // x+y
+    fp2sub1271(P->y, P->x, Q->yx);                    // y-x 
+    fp2mul1271(P->x, P->y, Q->t2);                    // t = x*y
+    fp2add1271(Q->t2, Q->t2, Q->t2);                  // 2*t
+    fp2mul1271(Q->t2, (felm_t*)&PARAMETER_d, Q->t2);  // 2d*t
+}
+
+
 static __inline void R5_to_R1(point_precomp_t P, point_extproj_t Q)      
 { // Conversion from representation (x+y,y-x,2dt) to (X,Y,Z,Ta,Tb) 
   // Input:  P = (x1+y1,y1-x1,2dt1) corresponding to (X1:Y1:Z1:T1) in extended twisted Edwards coordinates, where Z1=1
@@ -380,10 +427,16 @@ void eccmadd_ni(point_precomp_t Q, point_extproj_t P)
 }
 
 
-bool ecc_mul_fixed(digit_t* k, point_t Q)
+void R5_to_R1_ni(point_precomp_t P, point_extproj_t Q)
+{
+    R5_to_R1(P, Q);
+}
+
+
+static void ecc_mul_fixed_extproj(digit_t* k, point_extproj_t Q)
 { // Fixed-base scalar multiplication Q = k*G, where G is the generator. FIXED_BASE_TABLE stores v*2^(w-1) = 80 multiples of G.
   // Inputs: scalar "k" in [0, 2^256-1].
-  // Output: Q = k*G in affine coordinates (x,y).
+  // Output: Q = k*G in representation (X,Y,Z,Ta,Tb).
   // The function is based on the modified LSB-set comb method, which converts the scalar to an odd signed representation
   // with (bitlength(order)+w*v) digits.
     unsigned int j, w = W_FIXEDBASE, v = V_FIXEDBASE, d = D_FIXEDBASE, e = E_FIXEDBASE;
@@ -434,12 +487,46 @@ bool ecc_mul_fixed(digit_t* k, point_t Q)
             eccmadd(S, R);                                      // R = R+S using representations (X,Y,Z,Ta,Tb) <- (X,Y,Z,Ta,Tb) + (x+y,y-x,2dt)
         }        
     }     
-    eccnorm(R, Q);                                              // Conversion to affine coordinates (x,y) and modular correction. 
+    ecccopy(R, Q);                                              // Q = R
     
 #ifdef TEMP_ZEROING
     clear_words((void*)digits, NBITS_ORDER_PLUS_ONE+(W_FIXEDBASE*V_FIXEDBASE)-1);
     clear_words((void*)S, sizeof(point_precomp_t)/sizeof(unsigned int));
+    clear_words((void*)R, sizeof(point_extproj_t)/sizeof(unsigned int));
 #endif
+}
+
+
+bool ecc_mul_fixed(digit_t* k, point_t Q)
+{ // Fixed-base scalar multiplication Q = k*G, where G is the generator, using the modified LSB-set comb method.
+  // Inputs: scalar "k" in [0, 2^256-1].
+  // Output: Q = k*G in affine coordinates (x,y).
+    point_extproj_t R;
+
+    ecc_mul_fixed_extproj(k, R);
+    eccnorm(R, Q);                                              // Conversion to affine coordinates (x,y) and modular correction. 
+
+    return true;
+}
+
+
+bool ecc_mul_fixed_batch(digit_t* k, unsigned int n, point_t* Q)
+{ // Batched fixed-base scalar multiplication Q[i] = k[i]*G, where G is the generator, for i = 0,...,n-1.
+  // Inputs: n scalars k[i] in [0, 2^256-1], stored consecutively in "k" using NWORDS_ORDER digits each.
+  // Output: Q[i] = k[i]*G in affine coordinates (x,y).
+  // Each k[i]*G is computed as in ecc_mul_fixed(), and every NPOINTS_FIXED_BATCH results are normalized with a single inversion.
+    point_extproj_t R[NPOINTS_FIXED_BATCH];
+    unsigned int c, i, m;
+
+    for (c = 0; c < n; c += m)
+    {
+        m = (n-c < NPOINTS_FIXED_BATCH) ? (n-c) : NPOINTS_FIXED_BATCH;
+        for (i = 0; i < m; i++) {
+            ecc_mul_fixed_extproj(k + (c+i)*NWORDS_ORDER, R[i]);
+        }
+        eccnorm_batch(R, Q + c, m);                             // Conversion to affine coordinates (x,y) and modular correction
+    }
+
     return true;
 }
 
@@ -663,6 +750,455 @@ bool ecc_mul_double(digit_t* k, point_t Q, digit_t* l, point_t R)
 }
 
 
+#if (USE_ENDO == true)
+
+static bool ecc_mul_multi_straus(point_t* P, digit_t* k, unsigned int n, point_extproj_t S)
+{ // Multi-scalar multiplication S = k[0]*P[0] + ... + k[n-1]*P[n-1] using wNAF with interleaving (Straus) over the four-dimensional 
+  // decompositions, processing NPOINTS_MULTI_CHUNK points at a time.
+  // Output: S in representation (X,Y,Z,Ta,Tb). Returns false if some P[i] is not a point on the curve.
+    unsigned int c, i, j, m, position;
+    int d, digits[NPOINTS_MULTI_CHUNK][4][65];
+    point_extproj_t Q1, Q2, Q3, Q4, T;
+    point_extproj_precomp_t U, Q_table[NPOINTS_MULTI_CHUNK][4][NPOINTS_DOUBLEMUL_WQ];
+    uint64_t scalars[4];
+
+    for (c = 0; c < n; c += m)
+    {
+        m = (n-c < NPOINTS_MULTI_CHUNK) ? (n-c) : NPOINTS_MULTI_CHUNK;
+
+        for (i = 0; i < m; i++)
+        {
+            point_setup(P[c+i], Q1);                           // Convert to representation (X,Y,1,Ta,Tb)
+            if (ecc_point_validate(Q1) == false) {             // Check if point lies on the curve
+                return false;
+            }
+
+            // Computing endomorphisms over point P[c+i]
+            ecccopy(Q1, Q2);
+            ecc_phi(Q2);
+            ecccopy(Q1, Q3);    
+            ecc_psi(Q3); 
+            ecccopy(Q2, Q4); 
+            ecc_psi(Q4);  
+
+            decompose((uint64_t*)(k + (c+i)*NWORDS_ORDER), scalars);   // Scalar decomposition
+            for (j = 0; j < 4; j++) {
+                for (d = 0; d < 65; d++) {
+                    digits[i][j][d] = 0;
+                }
+                wNAF_recode(scalars[j], WQ_DOUBLEBASE, digits[i][j]);  // Scalar recoding
+            }
+            ecc_precomp_double(Q1, Q_table[i][0], NPOINTS_DOUBLEMUL_WQ);   // Precomputation
+            ecc_precomp_double(Q2, Q_table[i][1], NPOINTS_DOUBLEMUL_WQ); 
+            ecc_precomp_double(Q3, Q_table[i][2], NPOINTS_DOUBLEMUL_WQ); 
+            ecc_precomp_double(Q4, Q_table[i][3], NPOINTS_DOUBLEMUL_WQ); 
+        }
+
+        fp2zero1271(T->x);                                     // Initialize T as the neutral point (0:1:1)
+        fp2zero1271(T->y); T->y[0][0] = 1; 
+        fp2zero1271(T->z); T->z[0][0] = 1;     
+        fp2zero1271(T->ta);
+        fp2zero1271(T->tb);
+
+        for (d = 64; d >= 0; d--)
+        {
+            eccdouble(T);                                      // Double (X_T,Y_T,Z_T,Ta_T,Tb_T) = 2(X_T,Y_T,Z_T,Ta_T,Tb_T)
+            for (i = 0; i < m; i++) {
+                for (j = 0; j < 4; j++) {
+                    if (digits[i][j][d] < 0) {
+                        position = (-digits[i][j][d])/2;
+                        eccneg_extproj_precomp(Q_table[i][j][position], U);   // Load and negate U = (X_U,Y_U,Z_U,Td_U) <- -(X+Y,Y-X,2Z,2dT) from a point in the precomputed table 
+                        eccadd(U, T);                                         // T = T+U 
+                    } else if (digits[i][j][d] > 0) {
+                        position = (digits[i][j][d])/2;
+                        eccadd(Q_table[i][j][position], T);                   // T = T+U 
+                    }
+                }
+            }
+        }
+
+        if (c == 0) {
+            ecccopy(T, S);
+        } else {
+            R1_to_R2(T, U);
+            eccadd(U, S);                                      // Accumulate the chunks, S = S+T
+        }
+    }
+
+    return true;
+}
+
+
+static __inline int booth_digit(uint64_t scalar, unsigned int window, unsigned int c)
+{ // Signed digit of "window" in the Booth recoding of a 64-bit scalar with windows of c bits, in [-2^(c-1), 2^(c-1)]
+    uint64_t x;
+    unsigned int shift = window*c;
+
+    if (shift == 0) {
+        x = scalar << 1;                                       // Bit -1 is zero
+    } else if (shift <= 64) {
+        x = scalar >> (shift-1);
+    } else {
+        x = 0;
+    }
+    x &= ((uint64_t)1 << (c+1)) - 1;
+
+    return (int)((x + 1) >> 1) - (int)((x >> c) << c);
+}
+
+
+static bool ecc_mul_multi_pippenger(point_t* P, digit_t* k, unsigned int n, unsigned int c, point_precomp_t* Table, uint64_t* scalars, point_extproj_t* Buckets, unsigned char* used, point_extproj_t S)
+{ // Multi-scalar multiplication S = k[0]*P[0] + ... + k[n-1]*P[n-1] using buckets (Pippenger) over the 4n points and 64-bit scalars 
+  // given by the four-dimensional decompositions. Windows have c bits, Buckets and used have storage for 2^(c-1) entries.
+  // Output: S in representation (X,Y,Z,Ta,Tb). Returns false if some P[i] is not a point on the curve.
+    point_extproj_t E[NPOINTS_MULTI_CHUNK*4], Sum, W;
+    point_extproj_precomp_t U;
+    point_precomp_t V;
+    point_precomp *R;
+    point_t A[NPOINTS_MULTI_CHUNK*4];
+    unsigned int i, j, m, t = 0, base = 0, nbuckets = 1 << (c-1), nwindows = 64/c + 1;
+    int w, digit, started = 0, nonempty;
+
+    // Precomputation: P[i], Phi(P[i]), Psi(P[i]) and Phi(Psi(P[i])) in representation (x+y,y-x,2dt)
+    for (i = 0; i < n; i++)
+    {
+        point_setup(P[i], E[t]);                               // Convert to representation (X,Y,1,Ta,Tb)
+        if (ecc_point_validate(E[t]) == false) {               // Check if point lies on the curve
+            return false;
+        }
+        ecccopy(E[t], E[t+1]);
+        ecc_phi(E[t+1]);
+        ecccopy(E[t], E[t+2]);    
+        ecc_psi(E[t+2]); 
+        ecccopy(E[t+1], E[t+3]); 
+        ecc_psi(E[t+3]);  
+        decompose((uint64_t*)(k + i*NWORDS_ORDER), scalars + 4*i);     // Scalar decomposition
+        t += 4;
+
+        if (t == NPOINTS_MULTI_CHUNK*4 || i == n-1) {
+            eccnorm_batch(E, A, t);
+            for (j = 0; j < t; j++) {
+                point_setup_precomp(A[j], Table[base+j]);
+            }
+            base += t;
+            t = 0;
+        }
+    }
+
+    for (w = (int)nwindows-1; w >= 0; w--)
+    {
+        if (started) {
+            for (j = 0; j < c; j++) {
+                eccdouble(S);                                  // S = 2^c*S
+            }
+        }
+
+        for (j = 0; j < nbuckets; j++) {
+            used[j] = 0;
+        }
+        for (i = 0; i < 4*n; i++) {                            // Bucket accumulation, Buckets[|d|-1] += sign(d)*P
+            digit = booth_digit(scalars[i], w, c);
+            if (digit == 0) {
+                continue;
+            }
+            m = (digit > 0) ? (digit-1) : (-digit-1);
+            if (digit > 0) {
+                R = Table[i];
+            } else {
+                eccneg_precomp(Table[i], V);
+                R = V;
+            }
+            if (used[m]) {
+                eccmadd(R, Buckets[m]);
+            } else {
+                R5_to_R1(R, Buckets[m]);
+                used[m] = 1;
+            }
+        }
+
+        nonempty = 0;                                          // Bucket aggregation, W = sum (j+1)*Buckets[j], using running sums
+        for (j = nbuckets; j > 0; j--) {
+            if (used[j-1]) {
+                if (nonempty) {
+                    R1_to_R2(Buckets[j-1], U);
+                    eccadd(U, Sum);
+                } else {
+                    ecccopy(Buckets[j-1], Sum);
+                }
+            }
+            if (nonempty) {
+                R1_to_R2(Sum, U);
+                eccadd(U, W);
+            } else if (used[j-1]) {
+                ecccopy(Sum, W);
+                nonempty = 1;
+            }
+        }
+
+        if (nonempty) {
+            if (started) {
+                R1_to_R2(W, U);
+                eccadd(U, S);
+            } else {
+                ecccopy(W, S);
+                started = 1;
+            }
+        }
+    }
+
+    if (!started) {
+        fp2zero1271(S->x);                                     // All scalars are zero, S = (0:1:1)
+        fp2zero1271(S->y); S->y[0][0] = 1; 
+        fp2zero1271(S->z); S->z[0][0] = 1;     
+        fp2zero1271(S->ta);
+        fp2zero1271(S->tb);
+    }
+
+    return true;
+}
+
+#endif
+
+
+#if (USE_ENDO == true)
+
+static unsigned int ecc_mul_multi_window(unsigned int n)
+{ // Pippenger window for n points, c ~ log2(4n)-2 balances bucket accumulation and aggregation
+    unsigned int c = 4;
+
+    while (c < W_MULTI_PIPPENGER_MAX && (((unsigned long long)n << 2) >> (c+3)) != 0) {
+        c++;
+    }
+    return c;
+}
+
+
+size_t ecc_mul_multi_pippenger_bytes(unsigned int n, unsigned int c)
+{ // Bytes of scratch memory ecc_mul_multi_pippenger_scratch() uses for n points and a window of c bits
+    size_t nbuckets = (size_t)1 << (c-1);
+
+    return 4*(size_t)n*(sizeof(point_precomp_t) + sizeof(uint64_t)) + nbuckets*(sizeof(point_extproj_t) + 1);
+}
+
+
+bool ecc_mul_multi_pippenger_scratch(point_t* P, digit_t* k, unsigned int n, unsigned int c, point_t Q, void* scratch)
+{ // Multi-scalar multiplication Q = k[0]*P[0] + ... + k[n-1]*P[n-1] using buckets (Pippenger) with a window of c bits
+  // Inputs: n >= 1 points P[i] in affine coordinates, n scalars k[i] as in ecc_mul_multi_scratch(), 2 <= c <= W_MULTI_PIPPENGER_MAX,
+  //         scratch memory aligned to 8 bytes, of at least ecc_mul_multi_pippenger_bytes(n, c) bytes.
+  // Output: Q in affine coordinates (x,y). ecc_mul_multi_scratch() calls it with the window that suits n.
+    point_precomp_t* Table = (point_precomp_t*)scratch;       // 4n points, then 2^(c-1) buckets, 4n scalars and 2^(c-1) flags
+    point_extproj_t* Buckets = (point_extproj_t*)(Table + 4*n);
+    uint64_t* scalars = (uint64_t*)(Buckets + ((size_t)1 << (c-1)));
+    unsigned char* used = (unsigned char*)(scalars + 4*n);
+    point_extproj_t S;
+
+    if (n == 0 || c < 2 || c > W_MULTI_PIPPENGER_MAX) {
+        return false;
+    }
+    if (ecc_mul_multi_pippenger(P, k, n, c, Table, scalars, Buckets, used, S) == false) {
+        return false;
+    }
+    eccnorm(S, Q);                                             // Output Q = (x,y)
+
+    return true;
+}
+
+#endif
+
+
+size_t ecc_mul_multi_scratch_bytes(unsigned int n)
+{ // Bytes of scratch memory ecc_mul_multi_scratch() uses for n points, 0 if it needs none (Straus)
+#if (USE_ENDO == true)
+    if (n >= NPOINTS_MULTI_PIPPENGER) {
+        return ecc_mul_multi_pippenger_bytes(n, ecc_mul_multi_window(n));
+    }
+#endif
+    return 0;
+}
+
+
+bool ecc_mul_multi_scratch(point_t* P, digit_t* k, unsigned int n, point_t Q, void* scratch, size_t bytes)
+{ // Multi-scalar multiplication Q = k[0]*P[0] + ... + k[n-1]*P[n-1]
+  // Inputs: n >= 1 points P[i] in affine coordinates,
+  //         n scalars k[i] in [0, 2^256-1], stored consecutively in "k" using NWORDS_ORDER digits each,
+  //         scratch memory aligned to 8 bytes, of at least ecc_mul_multi_scratch_bytes(n) bytes, or NULL.
+  // Output: Q in affine coordinates (x,y).
+  // Below NPOINTS_MULTI_PIPPENGER points the function uses wNAF with interleaving (Straus), otherwise buckets (Pippenger) with a window 
+  // that grows with n, working in the scratch memory. Both work on the four-dimensional decompositions. Without enough scratch memory 
+  // Straus is used. The function does not allocate memory.
+            
+    // SECURITY NOTE: this function is intended for non-constant-time operations such as batch signature verification. 
+
+    point_extproj_t S;
+
+#if (USE_ENDO == true)
+    if (n >= NPOINTS_MULTI_PIPPENGER && scratch != NULL && bytes >= ecc_mul_multi_scratch_bytes(n)) {
+        return ecc_mul_multi_pippenger_scratch(P, k, n, ecc_mul_multi_window(n), Q, scratch);
+    }
+    if (ecc_mul_multi_straus(P, k, n, S) == false) {
+        return false;
+    }
+
+#else
+    point_t A;
+    point_extproj_t T;
+    point_extproj_precomp_t U;
+    unsigned int c;
+
+    (void)scratch;
+    (void)bytes;
+    for (c = 0; c < n; c++)
+    {
+        if (ecc_mul(P[c], k + c*NWORDS_ORDER, A, false) == false) {
+            return false;
+        }
+        point_setup(A, T);
+        if (c == 0) {
+            ecccopy(T, S);
+        } else {
+            R1_to_R2(T, U);
+            eccadd(U, S);
+        }
+    }
+#endif
+    eccnorm(S, Q);                                             // Output Q = (x,y)
+    
+    return true;
+}
+
+
+bool ecc_mul_multi(point_t* P, digit_t* k, unsigned int n, point_t Q)
+{ // Multi-scalar multiplication Q = k[0]*P[0] + ... + k[n-1]*P[n-1], see ecc_mul_multi_scratch()
+  // The scratch memory Pippenger needs is allocated on the heap; if it cannot be allocated Straus is used.
+    size_t bytes = ecc_mul_multi_scratch_bytes(n);
+    void* scratch = (bytes > 0) ? malloc(bytes) : NULL;
+    bool valid = ecc_mul_multi_scratch(P, k, n, Q, scratch, bytes);
+
+    free(scratch);
+    return valid;
+}
+
+
+bool ecc_precomp_cached(point_t Q, point_precomp_t* Table)
+{ // Generation of a precomputed table for repeated double scalar multiplications with the same point Q, see ecc_mul_double_cached().
+  // Input:  point Q in affine coordinates.
+  // Output: Table with storage for NPOINTS_CACHED_TABLE points, containing the odd multiples 1,3,...,2*NPOINTS_CACHED_WQ-1 of 
+  //         Q, Phi(Q), Psi(Q) and Phi(Psi(Q)), in this order, using representation (x+y,y-x,2dt).
+  // Returns false if Q is not a point on the curve.
+#if (USE_ENDO == true)
+    point_extproj_t Q4[4], P[NPOINTS_CACHED_TABLE];
+    point_extproj_precomp_t Q2;
+    point_t A[NPOINTS_CACHED_TABLE];
+    unsigned int i, j;
+
+    point_setup(Q, Q4[0]);                                     // Convert to representation (X,Y,1,Ta,Tb)
+    if (ecc_point_validate(Q4[0]) == false) {                  // Check if point lies on the curve
+        return false;
+    }
+
+    // Computing endomorphisms over point Q
+    ecccopy(Q4[0], Q4[1]);
+    ecc_phi(Q4[1]);
+    ecccopy(Q4[0], Q4[2]);    
+    ecc_psi(Q4[2]); 
+    ecccopy(Q4[1], Q4[3]); 
+    ecc_psi(Q4[3]);  
+
+    for (j = 0; j < 4; j++) {
+        ecccopy(Q4[j], P[j*NPOINTS_CACHED_WQ]);
+        eccdouble(Q4[j]);
+        R1_to_R2(Q4[j], Q2);                                   // Q2 = 2*Q_j in coordinates (X+Y,Y-X,2Z,2dT)
+        for (i = 1; i < NPOINTS_CACHED_WQ; i++) {
+            ecccopy(P[j*NPOINTS_CACHED_WQ+i-1], P[j*NPOINTS_CACHED_WQ+i]);
+            eccadd(Q2, P[j*NPOINTS_CACHED_WQ+i]);              // P[i] = P[i-1] + 2*Q_j
+        }
+    }
+
+    eccnorm_batch(P, A, NPOINTS_CACHED_TABLE);                 // A single inversion for the whole table
+    for (i = 0; i < NPOINTS_CACHED_TABLE; i++) {
+        point_setup_precomp(A[i], Table[i]);
+    }
+#else
+    point_extproj_t P;
+
+    point_setup(Q, P);
+    if (ecc_point_validate(P) == false) {
+        return false;
+    }
+    point_setup_precomp(Q, Table[0]);                          // Only Q itself is stored, ecc_mul_double() does the work
+#endif
+    return true;
+}
+
+
+bool ecc_mul_double_cached(digit_t* k, point_precomp_t* Table, digit_t* l, point_t R)
+{ // Double scalar multiplication R = k*G + l*Q, where the G is the generator and Q is given by its precomputed table.
+  // Inputs: Table generated by ecc_precomp_cached() for point Q,
+  //         scalars "k" and "l" in [0, 2^256-1].
+  // Output: R = k*G + l*Q in affine coordinates (x,y).
+  // The function uses wNAF with interleaving. Unlike ecc_mul_double(), Q is not validated nor precomputed again and its
+  // multiples are in affine form, so every addition is a mixed addition.
+            
+    // SECURITY NOTE: this function is intended for a non-constant-time operation such as signature verification. 
+
+#if (USE_ENDO == true)
+    unsigned int j, position;
+    int i, digits_k[4][65] = {{0}}, digits_l[4][65] = {{0}};
+    point_precomp_t V;
+    point_extproj_t T; 
+    uint64_t k_scalars[4], l_scalars[4];
+    
+    decompose((uint64_t*)k, k_scalars);                        // Scalar decomposition
+    decompose((uint64_t*)l, l_scalars);  
+    for (j = 0; j < 4; j++) {
+        wNAF_recode(k_scalars[j], WP_DOUBLEBASE, digits_k[j]); // Scalar recoding
+        wNAF_recode(l_scalars[j], WQ_CACHEDBASE, digits_l[j]);
+    }
+
+    fp2zero1271(T->x);                                         // Initialize T as the neutral point (0:1:1)
+    fp2zero1271(T->y); T->y[0][0] = 1; 
+    fp2zero1271(T->z); T->z[0][0] = 1;     
+
+    for (i = 64; i >= 0; i--)
+    {   
+        eccdouble(T);                                          // Double (X_T,Y_T,Z_T,Ta_T,Tb_T) = 2(X_T,Y_T,Z_T,Ta_T,Tb_T)
+        for (j = 0; j < 4; j++) {
+            if (digits_l[j][i] < 0) {
+                position = (-digits_l[j][i])/2;
+                eccneg_precomp(Table[j*NPOINTS_CACHED_WQ+position], V);    // Load and negate V = -(x+y,y-x,2dt) from the cached table 
+                eccmadd(V, T);                                             // T = T+V 
+            } else if (digits_l[j][i] > 0) {
+                position = (digits_l[j][i])/2;
+                eccmadd(Table[j*NPOINTS_CACHED_WQ+position], T);           // T = T+V 
+            }
+        }
+        for (j = 0; j < 4; j++) {
+            if (digits_k[j][i] < 0) {
+                position = (-digits_k[j][i])/2;
+                eccneg_precomp(((point_precomp_t*)&DOUBLE_SCALAR_TABLE)[j*NPOINTS_DOUBLEMUL_WP+position], V);
+                eccmadd(V, T);                              
+            } else if (digits_k[j][i] > 0) {
+                position = (digits_k[j][i])/2;
+                eccmadd(((point_precomp_t*)&DOUBLE_SCALAR_TABLE)[j*NPOINTS_DOUBLEMUL_WP+position], T);
+            }
+        }
+    }
+    eccnorm(T, R);                                             // Output R = (x,y)
+    
+    return true;
+#else
+    point_t Q;
+    point_extproj_t P;
+
+    R5_to_R1(Table[0], P);                                     // Recover Q = (X:Y:1)
+    fp2copy1271(P->x, Q->x);
+    fp2copy1271(P->y, Q->y);
+
+    return ecc_mul_double(k, Q, l, R);
+#endif
+}
+
+
 void ecc_precomp_double(point_extproj_t P, point_extproj_precomp_t* Table, unsigned int npoints)
 { // Generation of the precomputation table used internally by the double scalar multiplication function ecc_mul_double().  
   // Inputs: point P in representation (X,Y,Z,Ta,Tb),
@@ -0,0 +1,2359 @@
+/***********************************************************************************
+* ESEM: Energy-Aware Signature for Embedded Medical Devices, on top of FourQlib
+*
+*    Licensed under CC BY-NC 4.0, see the Licensing section of README.md
+*
+* Abstract: ESEM signer, server and verifier (libesem)
+************************************************************************************/
+
+#include "FourQ_internal.h"
+#include "esem.h"
+#include "tests/aes256.h"
+#include "../blake2b/blake2b.h"
+#include "../random/random.h"
+#include "zmq.h"
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if HIGH_SPEED
+    #define ESEM_HASH(h, x, key)  blake2b_40_16_32(h, x, key)
+#else
+    #define ESEM_HASH(h, x, key)  blake2b_36_16_32(h, x, key)
+#endif
+
+#define ESEM_KEYGEN_CHUNKS               ((BPV_N + ESEM_KEYGEN_CHUNK - 1)/ESEM_KEYGEN_CHUNK)
+#define ESEM_PAIR_INDEX(a, b)            ((b)*((b)+1)/2 + (a))     // Entry of publicPre[a]+publicPre[b], a <= b, in a block's pair table
+#define ESEM_ARENA_SLACK(size)           ((size) + ESEM_ARENA_ALIGN - 1)   // Arena bytes taken by a block of size bytes, at worst
+#define ESEM_COFACTOR                    392       // The curve has 392*N points, N being the prime order of G
+
+static const uint64_t ESEM_cofactor_inverse[4] = { 0x19FBEB877B2691F3, 0x5B1F37C5A96F4350, 0xA61E1145D66AD5E2, 0x0023EE839264702A };   // 392^-1 mod N
+
+typedef struct {
+    esem_table_mode_t mode;
+    unsigned int block;                    // Points per block of pairs: BPV_N for ESEM_TABLE_PAIRS
+    point_precomp_t *publicPre;            // BPV_N points in (x+y,y-x,2dt) form
+    point_precomp_t *pairs;                // (BPV_N/block) consecutive pair tables, NULL for ESEM_TABLE_NONE
+} esem_table_t;
+
+// Key generation jobs, handed out to the keygen threads in order
+typedef struct {
+    pthread_mutex_t lock;
+    unsigned int next;                     // Next job: level*chunks + chunk
+    unsigned int njobs;
+    unsigned char *tempKey[ESEM_L];
+    unsigned char *publicAll[ESEM_L];
+    unsigned char *secretAll[ESEM_L];
+    ECCRYPTO_STATUS status;
+} esem_keygen_t;
+
+// Signer state, expanded once from the long-lived keys: the keyed-BLAKE2b midstates of secret_key and of the level keys,
+// and for ESEMv1 the AES-256 key schedules of the level keys, derived from sk_aes as by ESEM_KeyGen_Seeded
+struct esem_signer {
+    aes256_context_t level[ESEM_L];
+    unsigned char tempKey[ESEM_L][32];
+    blake2b_midstate_t xKey;               // Keyed with secret_key: x = H(counter)
+    blake2b_midstate_t levelKey[ESEM_L];   // Keyed with the level keys: the indices of level l come from H(x)
+    uint64_t counter;                      // Next counter hashed into x, never reused
+};
+
+// The message-independent half of an ESEMv2 signature
+typedef struct {
+    unsigned char x[16];
+    digit_t r[NWORDS_ORDER];
+} esem_commit_t;
+
+// ESEMv2 signer that computes the (x, r) pairs ahead of the messages, see ESEM_Offline_Init
+struct esem_offline {
+    esem_signer_t signer;
+    const digit_t *secretAll[ESEM_L];
+    digit_t secret[NWORDS_ORDER];                 // secret_key in Montgomery representation
+    uint64_t counter;                             // Next counter hashed into x, never reused
+    esem_commit_t pool[ESEM_OFFLINE_POOL];        // Ready pairs: pool[head], ..., pool[head+count-1] (mod the pool size)
+    unsigned int head, count;
+    pthread_mutex_t lock;
+    pthread_cond_t consumed;                      // Wakes the refill thread
+    pthread_t thread;
+    int threaded, stop;
+};
+
+// Read-only once set up, shared by all the threads answering requests
+struct esem_server {
+    esem_table_t table[ESEM_L];
+    blake2b_midstate_t levelKey[ESEM_L];   // The hashing keys, absorbed once
+    void *context;                         // Set from ESEM_Server_Bind until ESEM_Server_Pool returns
+    void *frontend;                        // The ROUTER socket verifiers connect to, bound by ESEM_Server_Bind
+};
+
+typedef struct {
+    unsigned char public_key[64];
+    point_precomp_t *table;                // NPOINTS_CACHED_TABLE points, from the verifier's arena
+    unsigned long long last_used;          // 0 while the entry is free
+} esem_key_entry_t;
+
+typedef struct {
+    unsigned char public_key[64];
+    unsigned long long last_used;          // 0 while the entry is free
+} esem_checked_key_t;
+
+// Verifier state: one REQ socket per server, kept open across verifications, the ecc_precomp_cached() tables of the
+// last ESEM_KEY_CACHE_ENTRIES public keys, the last ESEM_CHECKED_KEY_ENTRIES keys found to have order N, and the
+// scratch buffers of ESEM_Verify_batch
+struct esem_verifier {
+    void *context;
+    void *requester[ESEM_L];
+    char endpoint[ESEM_L][ESEM_ENDPOINT_BYTES];
+    unsigned long long clock;
+    esem_key_entry_t entry[ESEM_KEY_CACHE_ENTRIES];
+    esem_checked_key_t *checked;           // ESEM_CHECKED_KEY_ENTRIES, in sets of ESEM_CHECKED_KEY_WAYS
+    unsigned int max_batch;
+    unsigned char *levels;                 // ESEM_L*max_batch
+    unsigned char *randValues;             // 16*max_batch
+    unsigned char *public_values;          // ESEM_L*max_batch*ESEM_RESPONSE_BYTES
+    point_extproj_t *RVerify;              // max_batch
+    point_t *points;                       // 2*max_batch
+    digit_t *scalars;                      // 2*max_batch*NWORDS_ORDER
+    digit_t *h;                            // max_batch*NWORDS_ORDER
+    void *msm;                             // ecc_mul_multi_scratch() memory for 2*max_batch points
+    size_t msm_bytes;
+};
+
+
+/**
+ * Sets up an arena over a caller-supplied buffer. The buffer need not be aligned: the first block starts at the
+ * first multiple of ESEM_ARENA_ALIGN inside it.
+ *
+ * @param arena The arena to set up.
+ * @param buffer The memory to carve blocks out of, owned by the caller.
+ * @param size The size of the buffer in bytes.
+ */
+void ESEM_Arena_Init(esem_arena_t *arena, void *buffer, size_t size)
+{
+    arena->base = (unsigned char*)buffer;
+    arena->size = size;
+    arena->used = 0;
+}
+
+
+/**
+ * Carves a block out of an arena. Blocks are aligned to ESEM_ARENA_ALIGN, so that no two of them share a cache line.
+ *
+ * @param arena The arena.
+ * @param size The size of the block in bytes.
+ * @return void* The zeroed block, or NULL if the arena is exhausted.
+ */
+void *ESEM_Arena_Alloc(esem_arena_t *arena, size_t size)
+{
+    size_t offset = (size_t)(-(uintptr_t)(arena->base + arena->used) & (ESEM_ARENA_ALIGN - 1)) + arena->used;
+    void *block;
+
+    if (offset > arena->size || size > arena->size - offset) {
+        return NULL;
+    }
+    block = arena->base + offset;
+    arena->used = offset + size;
+    memset(block, 0, size);
+
+    return block;
+}
+
+
+size_t ESEM_Tables_Size(void)
+{
+    return ESEM_ARENA_SLACK(ESEM_L*BPV_N*(64 + 32));
+}
+
+
+ECCRYPTO_STATUS ESEM_Tables_New(esem_arena_t *arena, unsigned char *publicAll[ESEM_L], unsigned char *secretAll[ESEM_L])
+{
+    unsigned char *tables = ESEM_Arena_Alloc(arena, ESEM_L*BPV_N*(64 + 32));
+    unsigned int l;
+
+    if (tables == NULL) {
+        return ECCRYPTO_ERROR_NO_MEMORY;
+    }
+    for (l = 0; l < ESEM_L; l++) {
+        publicAll[l] = tables + l*BPV_N*64;
+        secretAll[l] = tables + ESEM_L*BPV_N*64 + l*BPV_N*32;
+    }
+    return ECCRYPTO_SUCCESS;
+}
+
+
+size_t ESEM_Signer_Size(void)
+{
+    return ESEM_ARENA_SLACK(sizeof(esem_signer_t));
+}
+
+
+esem_signer_t *ESEM_Signer_New(esem_arena_t *arena)
+{
+    return ESEM_Arena_Alloc(arena, sizeof(esem_signer_t));
+}
+
+
+size_t ESEM_Offline_Size(void)
+{
+    return ESEM_ARENA_SLACK(sizeof(esem_offline_t));
+}
+
+
+esem_offline_t *ESEM_Offline_New(esem_arena_t *arena)
+{
+    return ESEM_Arena_Alloc(arena, sizeof(esem_offline_t));
+}
+
+static void ESEM_KeyGen_PRF(aes256_context_t *ctx, uint64_t index, unsigned char *out)
+{ // out = AES-256(2*index) || AES-256(2*index+1), each counter block holding the counter in its first 8 bytes (little endian)
+    aes256_encrypt_ctr(ctx, 2*index, 2, (aes256_blk_t *)out);
+}
+
+static ECCRYPTO_STATUS ESEM_KeyGen_Range(unsigned char *tempKey, unsigned int first, unsigned int count, unsigned char *publicAll, unsigned char *secretAll)
+{ // Generates the key pairs first, ..., first+count-1 of a level. Secret i is the PRF of i under the level's key, reduced mod the order
+    ECCRYPTO_STATUS Status;
+    aes256_context_t ctx;
+    unsigned int i;
+
+    aes256_init(&ctx, (aes256_key_t *)tempKey);
+    aes256_encrypt_ctr(&ctx, 2*(uint64_t)first, 2*count, (aes256_blk_t *)(secretAll + first*32));   // Same blocks as ESEM_KeyGen_PRF
+    for (i = first; i < first + count; i++) {
+        modulo_order((digit_t *)(secretAll + i*32), (digit_t *)(secretAll + i*32));
+    }
+    aes256_done(&ctx);
+
+    Status = PublicKeyGeneration_batch(secretAll + first*32, publicAll + first*64, count);
+
+    return Status;
+}
+
+static void *ESEM_KeyGen_Worker(void *arg)
+{ // Takes jobs until there are none left or some job failed
+    esem_keygen_t *keygen = (esem_keygen_t *)arg;
+    ECCRYPTO_STATUS Status;
+    unsigned int job, level, first, count;
+
+    while (1) {
+        pthread_mutex_lock(&keygen->lock);
+        job = keygen->next++;
+        if (keygen->status != ECCRYPTO_SUCCESS) {
+            job = keygen->njobs;
+        }
+        pthread_mutex_unlock(&keygen->lock);
+        if (job >= keygen->njobs) {
+            break;
+        }
+
+        level = job / ESEM_KEYGEN_CHUNKS;
+        first = (job % ESEM_KEYGEN_CHUNKS) * ESEM_KEYGEN_CHUNK;
+        count = (BPV_N - first < ESEM_KEYGEN_CHUNK) ? (BPV_N - first) : ESEM_KEYGEN_CHUNK;
+        Status = ESEM_KeyGen_Range(keygen->tempKey[level], first, count, keygen->publicAll[level], keygen->secretAll[level]);
+        if (Status != ECCRYPTO_SUCCESS) {
+            pthread_mutex_lock(&keygen->lock);
+            keygen->status = Status;
+            pthread_mutex_unlock(&keygen->lock);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Generates the ESEM keys deterministically from a seed.
+ *
+ * The seed keys an AES-256 PRF whose blocks 0..7 give the secret key and the three level keys. Each level key in turn keys
+ * the PRF that gives the BPV_N secrets of its table. The table entries are split in chunks of ESEM_KEYGEN_CHUNK over nthreads
+ * threads (at most ESEM_KEYGEN_MAX_THREADS); the output does not depend on the number of threads.
+ *
+ * @param seed The 32-byte seed.
+ * @param secret_key The buffer to store the generated secret key.
+ * @param public_key The buffer to store the generated public key.
+ * @param publicAll_1 The buffer to store the first set of generated public keys.
+ * @param publicAll_2 The buffer to store the second set of generated public keys.
+ * @param publicAll_3 The buffer to store the third set of generated public keys.
+ * @param secretAll_1 The buffer to store the first set of generated secret keys.
+ * @param secretAll_2 The buffer to store the second set of generated secret keys.
+ * @param secretAll_3 The buffer to store the third set of generated secret keys.
+ * @param tempKey1 The buffer to store the first level key.
+ * @param tempKey2 The buffer to store the second level key.
+ * @param tempKey3 The buffer to store the third level key.
+ * @param nthreads The number of threads, including the calling one.
+ * @return ECCRYPTO_STATUS The status of the key generation process.
+ */
+ECCRYPTO_STATUS ESEM_KeyGen_Seeded(const unsigned char seed[32], unsigned char *secret_key, unsigned char *public_key, unsigned char *publicAll_1, unsigned char *publicAll_2, unsigned char *publicAll_3, unsigned char *secretAll_1, unsigned char *secretAll_2, unsigned char *secretAll_3, unsigned char *tempKey1, unsigned char *tempKey2, unsigned char *tempKey3, unsigned int nthreads)
+{
+    ECCRYPTO_STATUS Status;
+    aes256_context_t ctx;
+    aes256_key_t key;
+    esem_keygen_t keygen = { PTHREAD_MUTEX_INITIALIZER, 0, ESEM_L*ESEM_KEYGEN_CHUNKS, {tempKey1, tempKey2, tempKey3}, {publicAll_1, publicAll_2, publicAll_3}, {secretAll_1, secretAll_2, secretAll_3}, ECCRYPTO_SUCCESS };
+    pthread_t threads[ESEM_KEYGEN_MAX_THREADS];
+    unsigned int i, started = 0;
+
+    if (nthreads == 0) {
+        return ECCRYPTO_ERROR_INVALID_PARAMETER;
+    }
+    if (nthreads > ESEM_KEYGEN_MAX_THREADS) {
+        nthreads = ESEM_KEYGEN_MAX_THREADS;
+    }
+
+    memcpy(key.raw, seed, 32);
+    aes256_init(&ctx, &key);
+    ESEM_KeyGen_PRF(&ctx, 0, secret_key);
+    modulo_order((digit_t *)secret_key, (digit_t *)secret_key);
+    for (i = 0; i < ESEM_L; i++) {
+        ESEM_KeyGen_PRF(&ctx, i + 1, keygen.tempKey[i]);
+    }
+    aes256_done(&ctx);
+    memset(key.raw, 0, 32);
+
+    Status = PublicKeyGeneration(secret_key, public_key);
+    if (Status != ECCRYPTO_SUCCESS) {
+        return Status;
+    }
+
+    for (i = 1; i < nthreads; i++) {       // If a thread cannot be started the others take its share
+        if (pthread_create(&threads[started], NULL, ESEM_KeyGen_Worker, &keygen) == 0) {
+            started++;
+        }
+    }
+    ESEM_KeyGen_Worker(&keygen);
+    for (i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_mutex_destroy(&keygen.lock);
+
+    return keygen.status;
+}
+
+/**
+ * Generates public and secret keys for the ESEM (Efficient Secure Enrollment Mechanism) protocol.
+ *
+ * This function draws a fresh AES-256 seed into sk_aes and expands it with ESEM_KeyGen_Seeded on ESEM_KEYGEN_THREADS
+ * threads (one per online core if 0).
+ *
+ * @param sk_aes The buffer to store the AES-256 seed.
+ * @param secret_key The buffer to store the generated secret key.
+ * @param public_key The buffer to store the generated public key.
+ * @param publicAll_1 The buffer to store the first set of generated public keys.
+ * @param publicAll_2 The buffer to store the second set of generated public keys.
+ * @param publicAll_3 The buffer to store the third set of generated public keys.
+ * @param secretAll_1 The buffer to store the first set of generated secret keys.
+ * @param secretAll_2 The buffer to store the second set of generated secret keys.
+ * @param secretAll_3 The buffer to store the third set of generated secret keys.
+ * @param tempKey1 The buffer to store the first temporary AES-256 key.
+ * @param tempKey2 The buffer to store the second temporary AES-256 key.
+ * @param tempKey3 The buffer to store the third temporary AES-256 key.
+ * @return ECCRYPTO_STATUS The status of the key generation process.
+ */
+ECCRYPTO_STATUS ESEM_KeyGen(unsigned char *sk_aes, unsigned char *secret_key, unsigned char *public_key, unsigned char *publicAll_1, unsigned char *publicAll_2, unsigned char *publicAll_3, unsigned char *secretAll_1, unsigned char *secretAll_2, unsigned char *secretAll_3, unsigned char *tempKey1, unsigned char *tempKey2, unsigned char *tempKey3)
+{
+    unsigned int nthreads = ESEM_KEYGEN_THREADS;
+    long cores;
+
+    if (nthreads == 0) {
+        cores = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = (cores > 0) ? (unsigned int)cores : 1;
+    }
+
+    if (random_bytes(sk_aes, 32) == false) {
+        return ECCRYPTO_ERROR;
+    }
+
+    return ESEM_KeyGen_Seeded(sk_aes, secret_key, public_key, publicAll_1, publicAll_2, publicAll_3, secretAll_1, secretAll_2, secretAll_3, tempKey1, tempKey2, tempKey3, nthreads);
+}
+
+// The ESEM_L (at most 4) level hashes of x, computed together. hashOutput[l] is the hash under the key of levelKey[l]
+static void ESEM_Hash_Levels(unsigned char hashOutput[4][ESEM_HASH_BYTES], const unsigned char randValue[16], const blake2b_midstate_t levelKey[ESEM_L])
+{
+    unsigned char *out[4];
+    const unsigned char *in[4];
+    const blake2b_midstate_t *state[4];
+    unsigned int l;
+
+    for (l = 0; l < 4; l++) {              // Spare lanes repeat the last level
+        out[l] = hashOutput[l];
+        in[l] = randValue;
+        state[l] = &levelKey[(l < ESEM_L) ? l : ESEM_L - 1];
+    }
+    blake2b_midstate_hash_x4(state, out, in, 16);
+}
+
+// Absorbs secret_key and the level keys of the signer into its BLAKE2b midstates
+static void ESEM_Signer_Hash_Keys(esem_signer_t *signer, const unsigned char secret_key[32])
+{
+    unsigned int l;
+
+    blake2b_midstate_init(&signer->xKey, secret_key, 16, 32);
+    for (l = 0; l < ESEM_L; l++) {
+        blake2b_midstate_init(&signer->levelKey[l], signer->tempKey[l], ESEM_HASH_BYTES, 32);
+    }
+}
+
+/**
+ * Expands the AES-256 key schedules used by the (v1) signer, the ones of the three level keys derived from sk_aes, and
+ * the BLAKE2b midstates of secret_key and of the level keys. Done once, so that ESEM_Signer_Sign only runs the PRF and
+ * one compression per hash. The level keys are derived with the PRF of ESEM_KeyGen_Seeded, so with sk_aes the seed of
+ * the keys, the secrets recomputed by ESEM_Signer_Sign are those of the secret tables.
+ *
+ * Each signature takes the next counter, so x, and the secrets it selects, are never used twice. A counter must never
+ * be used twice with the same keys, so a device that restarts has to resume from the counter ESEM_Signer_Done returned.
+ *
+ * @param signer The signer state to fill.
+ * @param sk_aes The AES-256 key generation seed.
+ * @param secret_key The Schnorr secret key.
+ * @param counter The first counter to use.
+ */
+void ESEM_Signer_Init(esem_signer_t *signer, const unsigned char sk_aes[32], const unsigned char secret_key[32], uint64_t counter)
+{
+    aes256_context_t seed;
+    aes256_key_t key;
+    unsigned int l;
+
+    memcpy(key.raw, sk_aes, 32);
+    aes256_init(&seed, &key);
+    for (l = 0; l < ESEM_L; l++) {
+        ESEM_KeyGen_PRF(&seed, l + 1, signer->tempKey[l]);
+        aes256_init(&signer->level[l], (aes256_key_t *)signer->tempKey[l]);
+    }
+    aes256_done(&seed);
+    memset(key.raw, 0, 32);
+    ESEM_Signer_Hash_Keys(signer, secret_key);
+    signer->counter = counter;
+}
+
+/**
+ * Sets up an ESEMv2 signer: the BLAKE2b midstates of secret_key and of the level keys, so that each hash of
+ * ESEM_Signer_Sign_v2 is a single compression. The AES schedules are left unset. Counters are used as with
+ * ESEM_Signer_Init.
+ *
+ * @param signer The signer state to fill.
+ * @param secret_key The Schnorr secret key.
+ * @param tempKey1 The first level key.
+ * @param tempKey2 The second level key.
+ * @param tempKey3 The third level key.
+ * @param counter The first counter to use.
+ */
+void ESEM_Signer_Init_v2(esem_signer_t *signer, const unsigned char secret_key[32], const unsigned char tempKey1[32], const unsigned char tempKey2[32], const unsigned char tempKey3[32], uint64_t counter)
+{
+    memset(signer, 0, sizeof(*signer));
+    memcpy(signer->tempKey[0], tempKey1, 32);
+    memcpy(signer->tempKey[1], tempKey2, 32);
+    memcpy(signer->tempKey[2], tempKey3, 32);
+    ESEM_Signer_Hash_Keys(signer, secret_key);
+    signer->counter = counter;
+}
+
+// Clears the signer state. Returns the first counter that has not been used, to resume from.
+uint64_t ESEM_Signer_Done(esem_signer_t *signer)
+{
+    uint64_t counter = signer->counter;
+    unsigned int l;
+
+    for (l = 0; l < ESEM_L; l++) {
+        aes256_done(&signer->level[l]);
+    }
+    memset(signer, 0, sizeof(*signer));
+    return counter;
+}
+
+/**
+ * Signs message with the key schedules of an initialized signer (ESEMv1: the secrets are recomputed instead of looked up).
+ *
+ * Secret i of a level is the PRF of the blocks (2i, 2i+1) under the level key, reduced mod the order, as in
+ * ESEM_KeyGen_Range. The BPV_V indices of a level are encrypted together by aes256_encrypt_ctr_gather, so the AES
+ * pipeline stays full. The PRF outputs of all levels are then added unreduced and r is reduced once, by sum_mod_order.
+ *
+ * @param signer The signer state, see ESEM_Signer_Init. Its counter advances.
+ * @param secret_key The Schnorr secret key the signer was set up with.
+ * @param message The 32-byte message.
+ * @param signature The buffer to store the 48-byte signature, x || s.
+ * @return ECCRYPTO_STATUS The status of the signing process.
+ */
+ECCRYPTO_STATUS ESEM_Signer_Sign(esem_signer_t *signer, unsigned char secret_key[32], unsigned char *message, unsigned char *signature)
+{
+    aes256_blk_t prf_out[ESEM_L][2*BPV_V];
+    uint64_t indices[BPV_V];
+    unsigned int i, l;
+    uint64_t c = signer->counter++;
+
+    unsigned char randValue[16] = {0}; //This is x in the scheme
+    unsigned char counter[8];
+    unsigned char hashOutput[4][ESEM_HASH_BYTES];
+    unsigned char hashedMsg[32] = {0};
+
+    digit_t r[NWORDS_ORDER] = {0};
+    digit_t Secret[NWORDS_ORDER];
+    digit_t* S = (digit_t*)(signature+16);
+
+    memcpy(counter, &c, 8);
+    blake2b_midstate_hash(&signer->xKey, randValue, counter, 8);
+
+    memcpy(signature, randValue,  16);
+
+    ESEM_Hash_Levels(hashOutput, randValue, signer->levelKey);
+
+    for (l = 0; l < ESEM_L; l++) {
+        for (i = 0; i < BPV_V; ++i) {
+            indices[i] = 2*(uint64_t)BPV_INDEX(hashOutput[l], i);
+        }
+        aes256_encrypt_ctr_gather(&signer->level[l], indices, BPV_V, 2, prf_out[l]);
+    }
+    sum_mod_order((digit_t*)prf_out, ESEM_L*BPV_V, r);   // r = sum of the r_i's, reduced once
+
+    blake2b_32_32_16(hashedMsg, message, randValue);
+
+    modulo_order((digit_t*)hashedMsg, (digit_t*)hashedMsg);
+
+    to_Montgomery((digit_t*)hashedMsg, S);
+    to_Montgomery((digit_t*)secret_key, Secret);
+    Montgomery_multiply_mod_order(S, Secret, S);
+    from_Montgomery(S, S);
+    subtract_mod_order(r, S, S);
+
+    memset(prf_out, 0, sizeof(prf_out));
+
+    return ECCRYPTO_SUCCESS;
+}
+
+// One-shot ESEMv1 signature: expands the key schedules of sk_aes, signs with the given counter, and clears them.
+// The caller keeps the counter and must never pass the same one twice with the same keys.
+ECCRYPTO_STATUS ESEM_Sign(unsigned char sk_aes[32], unsigned char secret_key[32], unsigned char *message, uint64_t counter, unsigned char *signature){
+
+    ECCRYPTO_STATUS Status;
+    esem_signer_t signer;
+
+    ESEM_Signer_Init(&signer, sk_aes, secret_key, counter);
+    Status = ESEM_Signer_Sign(&signer, secret_key, message, signature);
+    ESEM_Signer_Done(&signer);
+
+    return Status;
+}
+
+// The message-independent half of an ESEMv2 signature: x = H(counter) under secret_key, and r = sum of the secrets that
+// the level hashes of x select in the secret tables
+static void ESEM_Signer_Commit(const esem_signer_t *signer, const unsigned char counter[8], const digit_t *const secretAll[ESEM_L], unsigned char randValue[16], digit_t r[NWORDS_ORDER])
+{
+    unsigned char hashOutput[4][ESEM_HASH_BYTES];
+    unsigned int indices[ESEM_L*BPV_V];
+    unsigned int i, l;
+
+    blake2b_midstate_hash(&signer->xKey, randValue, counter, 8);
+
+    ESEM_Hash_Levels(hashOutput, randValue, signer->levelKey);   // The l hashes are independent
+
+    for (l = 0; l < ESEM_L; l++) {
+        for (i = 0; i < BPV_V; ++i) { 
+            indices[l*BPV_V + i] = BPV_INDEX(hashOutput[l], i);
+        }
+    }
+    sum_mod_order_gather(secretAll, indices, ESEM_L, BPV_V, r);   // r = sum of the r_i's, reduced once
+}
+
+/**
+ * Signs message with an ESEMv2 signer, looking the secrets up in the secret tables.
+ *
+ * @param signer The signer state, see ESEM_Signer_Init_v2. Its counter advances.
+ * @param secret_key The Schnorr secret key the signer was set up with.
+ * @param message The 32-byte message.
+ * @param secretAll_1 The first secret table.
+ * @param secretAll_2 The second secret table.
+ * @param secretAll_3 The third secret table.
+ * @param signature The buffer to store the 48-byte signature, x || s.
+ * @return ECCRYPTO_STATUS The status of the signing process.
+ */
+ECCRYPTO_STATUS ESEM_Signer_Sign_v2(esem_signer_t *signer, unsigned char secret_key[32], unsigned char *message, const unsigned char *secretAll_1, const unsigned char *secretAll_2, const unsigned char *secretAll_3, unsigned char *signature){
+
+    unsigned char randValue[16] = {0}; //This is x in the scheme
+    unsigned char counter[8];
+    uint64_t c = signer->counter++;
+    const digit_t *secretAll[ESEM_L] = {(const digit_t*)secretAll_1, (const digit_t*)secretAll_2, (const digit_t*)secretAll_3};
+
+    unsigned char secretTemp2[32];
+    digit_t r[NWORDS_ORDER] = {0};
+    digit_t* S = (digit_t*)(signature+16);  
+    digit_t* Secret = (digit_t*)(secretTemp2);  
+
+
+    memcpy(counter, &c, 8);
+    ESEM_Signer_Commit(signer, counter, secretAll, randValue, r);
+
+    memcpy(signature, randValue,  16);
+
+
+    unsigned char hashedMsg[32] = {0}; 
+    blake2b_32_32_16(hashedMsg, message, randValue);
+
+    modulo_order((digit_t*)hashedMsg, (digit_t*)hashedMsg);
+
+    to_Montgomery((digit_t*)hashedMsg, S);
+    to_Montgomery((digit_t*)secret_key, Secret);
+    Montgomery_multiply_mod_order(S, Secret, S);
+    from_Montgomery(S, S);
+    subtract_mod_order(r, S, S);
+
+
+
+    return ECCRYPTO_SUCCESS;
+
+}
+
+// One-shot ESEMv2 signature: sets up a signer for the keys, signs with the given counter, and clears it.
+// The caller keeps the counter and must never pass the same one twice with the same keys.
+ECCRYPTO_STATUS ESEM_Sign_v2(unsigned char secret_key[32], unsigned char *message, const unsigned char *secretAll_1, const unsigned char *secretAll_2, const unsigned char *secretAll_3, unsigned char tempKey1[32], unsigned char tempKey2[32], unsigned char tempKey3[32], uint64_t counter, unsigned char *signature){
+
+    ECCRYPTO_STATUS Status;
+    esem_signer_t signer;
+
+    ESEM_Signer_Init_v2(&signer, secret_key, tempKey1, tempKey2, tempKey3, counter);
+    Status = ESEM_Signer_Sign_v2(&signer, secret_key, message, secretAll_1, secretAll_2, secretAll_3, signature);
+    ESEM_Signer_Done(&signer);
+
+    return Status;
+}
+
+
+// Computes the pair of the next counter and, if there is room, adds it to the pool. Returns 0 once the pool is full
+static int ESEM_Offline_Produce(esem_offline_t *offline)
+{
+    esem_commit_t commit;
+    unsigned char counter[8];
+    uint64_t c;
+    int added = 0;
+
+    pthread_mutex_lock(&offline->lock);
+    if (offline->count == ESEM_OFFLINE_POOL) {
+        pthread_mutex_unlock(&offline->lock);
+        return 0;
+    }
+    c = offline->counter++;
+    pthread_mutex_unlock(&offline->lock);
+
+    memcpy(counter, &c, 8);
+    ESEM_Signer_Commit(&offline->signer, counter, offline->secretAll, commit.x, commit.r);
+
+    pthread_mutex_lock(&offline->lock);
+    if (offline->count < ESEM_OFFLINE_POOL) {     // Another producer may have filled the pool meanwhile; the pair is then dropped
+        offline->pool[(offline->head + offline->count) % ESEM_OFFLINE_POOL] = commit;
+        offline->count++;
+        added = 1;
+    }
+    pthread_mutex_unlock(&offline->lock);
+    memset(&commit, 0, sizeof(commit));
+
+    return added;
+}
+
+static void *ESEM_Offline_Worker(void *arg)
+{
+    esem_offline_t *offline = (esem_offline_t*)arg;
+
+    pthread_mutex_lock(&offline->lock);
+    while (!offline->stop) {
+        if (offline->count == ESEM_OFFLINE_POOL) {
+            pthread_cond_wait(&offline->consumed, &offline->lock);
+            continue;
+        }
+        pthread_mutex_unlock(&offline->lock);
+        ESEM_Offline_Produce(offline);
+        pthread_mutex_lock(&offline->lock);
+    }
+    pthread_mutex_unlock(&offline->lock);
+
+    return NULL;
+}
+
+/**
+ * Refills the pool of an offline signer up to ESEM_OFFLINE_POOL pairs. Meant for idle time when the signer has no
+ * refill thread.
+ *
+ * @param offline The offline signer.
+ * @return unsigned int The number of pairs added.
+ */
+unsigned int ESEM_Offline_Fill(esem_offline_t *offline)
+{
+    unsigned int added = 0;
+
+    while (ESEM_Offline_Produce(offline)) {
+        added++;
+    }
+    return added;
+}
+
+/**
+ * Sets up an offline/online ESEMv2 signer. Neither x nor r depends on the message, so the signer computes (x, r) pairs
+ * ahead of time, x = H(counter) under secret_key with an advancing counter, and signing a message is then only
+ * H(message, x), one multiplication modulo the order and a subtraction.
+ *
+ * The pool is filled before returning. With background set, a thread refills it as pairs are used; otherwise the caller
+ * refills it with ESEM_Offline_Fill. A counter must never be used twice with the same keys, so a device that restarts
+ * has to resume from a counter past the last one it used (see ESEM_Offline_Done).
+ *
+ * @param offline The offline signer to set up.
+ * @param secret_key The Schnorr secret key, reduced mod the order.
+ * @param secretAll_1 The first secret table, kept by reference.
+ * @param secretAll_2 The second secret table, kept by reference.
+ * @param secretAll_3 The third secret table, kept by reference.
+ * @param tempKey1 The first level key.
+ * @param tempKey2 The second level key.
+ * @param tempKey3 The third level key.
+ * @param counter The first counter to use.
+ * @param background Nonzero to refill the pool from a thread.
+ * @return ECCRYPTO_STATUS The status of the setup.
+ */
+ECCRYPTO_STATUS ESEM_Offline_Init(esem_offline_t *offline, const unsigned char secret_key[32], const unsigned char *secretAll_1, const unsigned char *secretAll_2, const unsigned char *secretAll_3, const unsigned char tempKey1[32], const unsigned char tempKey2[32], const unsigned char tempKey3[32], uint64_t counter, int background)
+{
+    memset(offline, 0, sizeof(*offline));
+    ESEM_Signer_Init_v2(&offline->signer, secret_key, tempKey1, tempKey2, tempKey3, counter);
+    offline->secretAll[0] = (const digit_t*)secretAll_1;
+    offline->secretAll[1] = (const digit_t*)secretAll_2;
+    offline->secretAll[2] = (const digit_t*)secretAll_3;
+    to_Montgomery((digit_t*)secret_key, offline->secret);
+    offline->counter = counter;
+    pthread_mutex_init(&offline->lock, NULL);
+    pthread_cond_init(&offline->consumed, NULL);
+
+    ESEM_Offline_Fill(offline);
+
+    if (background) {
+        if (pthread_create(&offline->thread, NULL, ESEM_Offline_Worker, offline) != 0) {
+            pthread_cond_destroy(&offline->consumed);
+            pthread_mutex_destroy(&offline->lock);
+            ESEM_Signer_Done(&offline->signer);
+            memset(offline, 0, sizeof(*offline));
+            return ECCRYPTO_ERROR;
+        }
+        offline->threaded = 1;
+    }
+    return ECCRYPTO_SUCCESS;
+}
+
+/**
+ * Signs message with a pair from the pool. If the pool has run dry, the pair is computed on the spot.
+ *
+ * s = r - H(message, x)*secret_key: the hash is not reduced first, since the Montgomery product of a 256-bit value and
+ * secret_key*R (mod the order) is already H*secret_key mod the order.
+ *
+ * @param offline The offline signer, see ESEM_Offline_Init.
+ * @param message The 32-byte message.
+ * @param signature The buffer to store the 48-byte signature, x || s.
+ * @return ECCRYPTO_STATUS The status of the signing process.
+ */
+ECCRYPTO_STATUS ESEM_Offline_Sign(esem_offline_t *offline, unsigned char *message, unsigned char *signature)
+{
+    esem_commit_t commit;
+    unsigned char counter[8];
+    digit_t hashedMsg[NWORDS_ORDER];
+    digit_t* S = (digit_t*)(signature+16);
+    uint64_t c;
+
+    pthread_mutex_lock(&offline->lock);
+    if (offline->count > 0) {
+        commit = offline->pool[offline->head];
+        memset(&offline->pool[offline->head], 0, sizeof(esem_commit_t));
+        offline->head = (offline->head + 1) % ESEM_OFFLINE_POOL;
+        offline->count--;
+        pthread_cond_signal(&offline->consumed);
+        pthread_mutex_unlock(&offline->lock);
+    } else {
+        c = offline->counter++;
+        pthread_mutex_unlock(&offline->lock);
+        memcpy(counter, &c, 8);
+        ESEM_Signer_Commit(&offline->signer, counter, offline->secretAll, commit.x, commit.r);
+    }
+
+    memcpy(signature, commit.x, 16);
+    blake2b_32_32_16((unsigned char*)hashedMsg, message, commit.x);
+    Montgomery_multiply_mod_order(hashedMsg, offline->secret, S);   // S = H(message, x)*secret_key mod order
+    subtract_mod_order(commit.r, S, S);
+
+    memset(&commit, 0, sizeof(commit));
+    return ECCRYPTO_SUCCESS;
+}
+
+/**
+ * Stops the refill thread of an offline signer, if any, and clears its state. The pairs still in the pool are discarded
+ * and their counters are not reused.
+ *
+ * @param offline The offline signer.
+ * @return uint64_t The first counter that has not been used, to resume from.
+ */
+uint64_t ESEM_Offline_Done(esem_offline_t *offline)
+{
+    uint64_t counter;
+
+    if (offline->threaded) {
+        pthread_mutex_lock(&offline->lock);
+        offline->stop = 1;
+        pthread_cond_signal(&offline->consumed);
+        pthread_mutex_unlock(&offline->lock);
+        pthread_join(offline->thread, NULL);
+    }
+    counter = offline->counter;
+    pthread_cond_destroy(&offline->consumed);
+    pthread_mutex_destroy(&offline->lock);
+    ESEM_Signer_Done(&offline->signer);
+    memset(offline, 0, sizeof(*offline));
+
+    return counter;
+}
+
+// ESEM_Signer_Commit for ESEM_SIGN_LANES counters at once. The x hashes, and the ESEM_SIGN_LANES*ESEM_L level hashes, are
+// spread over the four BLAKE2b lanes, and the table gathers of all signatures are issued back to back
+static void ESEM_Signer_Commit_x4(const esem_signer_t *signer, unsigned char counter[ESEM_SIGN_LANES][8], const digit_t *const secretAll[ESEM_L], unsigned char randValue[ESEM_SIGN_LANES][16], digit_t r[ESEM_SIGN_LANES][NWORDS_ORDER])
+{
+    unsigned char hashOutput[ESEM_SIGN_LANES*ESEM_L][ESEM_HASH_BYTES];
+    unsigned int indices[ESEM_SIGN_LANES][ESEM_L*BPV_V];
+    unsigned char *out[4];
+    const unsigned char *in[4];
+    const blake2b_midstate_t *state[4];
+    unsigned int i, j, k, l;
+
+    for (j = 0; j < 4; j++) {
+        out[j] = randValue[j];
+        in[j] = counter[j];
+        state[j] = &signer->xKey;
+    }
+    blake2b_midstate_hash_x4(state, out, in, 8);
+
+    for (k = 0; k < ESEM_SIGN_LANES*ESEM_L; k += 4) {   // Hash k is level k % ESEM_L of signature k / ESEM_L
+        for (j = 0; j < 4; j++) {
+            out[j] = hashOutput[k + j];
+            in[j] = randValue[(k + j)/ESEM_L];
+            state[j] = &signer->levelKey[(k + j) % ESEM_L];
+        }
+        blake2b_midstate_hash_x4(state, out, in, 16);
+    }
+
+    for (j = 0; j < ESEM_SIGN_LANES; j++) {
+        for (l = 0; l < ESEM_L; l++) {
+            for (i = 0; i < BPV_V; ++i) {
+                indices[j][l*BPV_V + i] = BPV_INDEX(hashOutput[j*ESEM_L + l], i);
+            }
+        }
+    }
+    for (j = 0; j < ESEM_SIGN_LANES; j++) {
+        sum_mod_order_gather(secretAll, indices[j], ESEM_L, BPV_V, r[j]);
+    }
+}
+
+/**
+ * Signs n messages with the keys of an offline signer, ESEM_SIGN_LANES at a time. Each signature takes a fresh counter
+ * (the pool is left for ESEM_Offline_Sign), and the BLAKE2b work of the ESEM_SIGN_LANES signatures (x, level and
+ * message hashes) runs in the four lanes of the multi-buffer hash. Signature i is the one ESEM_Offline_Sign would give
+ * message i for the same counter.
+ *
+ * @param offline The offline signer, see ESEM_Offline_Init.
+ * @param messages The n 32-byte messages, one after the other.
+ * @param n The number of messages.
+ * @param signatures The buffer to store the n 48-byte signatures, x || s, one after the other.
+ * @return ECCRYPTO_STATUS The status of the signing process.
+ */
+ECCRYPTO_STATUS ESEM_Sign_batch(esem_offline_t *offline, const unsigned char *messages, unsigned int n, unsigned char *signatures)
+{
+    unsigned char counter[ESEM_SIGN_LANES][8];
+    unsigned char randValue[ESEM_SIGN_LANES][16];
+    digit_t r[ESEM_SIGN_LANES][NWORDS_ORDER];
+    digit_t hashedMsg[ESEM_SIGN_LANES][NWORDS_ORDER];
+    digit_t S[NWORDS_ORDER];
+    unsigned char *out[4];
+    const unsigned char *in[4], *key[4];
+    unsigned int i, j, lanes;
+    uint64_t c;
+
+    pthread_mutex_lock(&offline->lock);
+    c = offline->counter;
+    offline->counter += n;
+    pthread_mutex_unlock(&offline->lock);
+
+    for (i = 0; i < n; i += lanes) {
+        lanes = (n - i < ESEM_SIGN_LANES) ? n - i : ESEM_SIGN_LANES;
+        for (j = 0; j < ESEM_SIGN_LANES; j++) {        // Spare lanes of the last group repeat its last signature
+            uint64_t cj = c + i + ((j < lanes) ? j : lanes - 1);
+            memcpy(counter[j], &cj, 8);
+        }
+        ESEM_Signer_Commit_x4(&offline->signer, counter, offline->secretAll, randValue, r);
+
+        for (j = 0; j < 4; j++) {
+            out[j] = (unsigned char*)hashedMsg[j];
+            in[j] = messages + 32*(i + ((j < lanes) ? j : lanes - 1));
+            key[j] = randValue[j];
+        }
+        blake2b_32_32_16_x4(out, in, key);
+
+        for (j = 0; j < lanes; j++) {
+            memcpy(signatures + 48*(i + j), randValue[j], 16);
+            Montgomery_multiply_mod_order(hashedMsg[j], offline->secret, S);   // S = H(message, x)*secret_key mod order
+            subtract_mod_order(r[j], S, S);
+            memcpy(signatures + 48*(i + j) + 16, S, 32);
+        }
+    }
+
+    memset(r, 0, sizeof(r));
+    memset(S, 0, sizeof(S));
+    return ECCRYPTO_SUCCESS;
+}
+
+static int ESEM_Parse_Request(const unsigned char *request, size_t len, unsigned char *randValue)
+{ // Checks a single request. Returns the requested level, or -1 if the request is malformed
+    if (len != ESEM_REQUEST_BYTES || request[0] != CMD_REQUEST_VERIFICATION || request[1] >= ESEM_L) {
+        return -1;
+    }
+    memcpy(randValue, request + 2, 16);
+
+    return request[1];
+}
+
+
+/**
+ * Converts a public table to the (x+y,y-x,2dt) representation used by the server.
+ *
+ * Done once when the table is loaded, so that answering a request is a chain of mixed additions.
+ *
+ * @param publicAll The BPV_N 64-byte affine points of the level.
+ * @param publicPre The buffer to store the BPV_N precomputed points.
+ */
+static void ESEM_Precompute_Table(const unsigned char *publicAll, point_precomp_t *publicPre)
+{
+    point_affine P;
+    uint64_t i;
+
+    for (i = 0; i < BPV_N; ++i) {
+        memmove(&P, publicAll + 64*i, 64);
+        point_setup_precomp(&P, publicPre[i]);
+    }
+}
+
+
+static void ESEM_Precompute_Pairs(esem_table_t *table)
+{ // Fills table->pairs with publicPre[a]+publicPre[b] for every a <= b inside each block, in ESEM_PAIR_INDEX order
+    point_extproj_t R[ESEM_BATCH_SIZE];
+    point_t S[ESEM_BATCH_SIZE];
+    unsigned int blk, a, b, i, n = 0, k = 0;
+
+    for (blk = 0; blk < BPV_N/table->block; blk++) {
+        point_precomp_t *P = table->publicPre + blk*table->block;
+
+        for (b = 0; b < table->block; b++) {
+            for (a = 0; a <= b; a++) {
+                R5_to_R1_ni(P[a], R[n]);
+                eccmadd_ni(P[b], R[n]);
+                if (++n == ESEM_BATCH_SIZE) {
+                    eccnorm_batch(R, S, n);
+                    for (i = 0; i < n; i++) {
+                        point_setup_precomp(S[i], table->pairs[k++]);
+                    }
+                    n = 0;
+                }
+            }
+        }
+    }
+    if (n > 0) {
+        eccnorm_batch(R, S, n);
+        for (i = 0; i < n; i++) {
+            point_setup_precomp(S[i], table->pairs[k++]);
+        }
+    }
+}
+
+
+static size_t ESEM_Table_Pairs(esem_table_mode_t mode)
+{ // Number of pair sums precomputed in mode
+    unsigned int block = (mode == ESEM_TABLE_PAIRS) ? BPV_N : ESEM_TABLE_BLOCK;
+
+    return (mode == ESEM_TABLE_NONE) ? 0 : (BPV_N/block)*ESEM_PAIR_INDEX(0, block);
+}
+
+
+/**
+ * Loads a public table into the form used by the server.
+ *
+ * ESEM_TABLE_NONE keeps the BPV_N points. ESEM_TABLE_PAIRS adds the sum of every pair of points, so that a request
+ * costs about BPV_V/2 additions. ESEM_TABLE_BLOCKED only adds the pairs inside blocks of ESEM_TABLE_BLOCK points,
+ * which is much smaller and still pairs up most of the indices.
+ *
+ * @param arena The arena to carve the precomputed points out of.
+ * @param publicAll The public table of the level.
+ * @param mode The precomputation to perform.
+ * @param table The table to fill.
+ * @return ECCRYPTO_STATUS The status of the loading.
+ */
+static ECCRYPTO_STATUS ESEM_Load_Table(esem_arena_t *arena, const unsigned char *publicAll, esem_table_mode_t mode, esem_table_t *table)
+{
+    table->mode = mode;
+    table->block = (mode == ESEM_TABLE_PAIRS) ? BPV_N : ESEM_TABLE_BLOCK;
+    table->pairs = NULL;
+    table->publicPre = ESEM_Arena_Alloc(arena, BPV_N*sizeof(point_precomp_t));
+    if (table->publicPre == NULL) {
+        return ECCRYPTO_ERROR_NO_MEMORY;
+    }
+    ESEM_Precompute_Table(publicAll, table->publicPre);
+
+    if (mode != ESEM_TABLE_NONE) {
+        table->pairs = ESEM_Arena_Alloc(arena, ESEM_Table_Pairs(mode)*sizeof(point_precomp_t));
+        if (table->pairs == NULL) {
+            return ECCRYPTO_ERROR_NO_MEMORY;
+        }
+        ESEM_Precompute_Pairs(table);
+    }
+
+    return ECCRYPTO_SUCCESS;
+}
+
+
+static __inline void ESEM_Accumulate(point_precomp_t P, point_extproj_t R, int *empty)
+{
+    if (*empty) {
+        R5_to_R1_ni(P, R);
+        *empty = 0;
+    } else {
+        eccmadd_ni(P, R);
+    }
+}
+
+
+/**
+ * Sums the BPV_V table points selected by the level hash of x, leaving the result in extended coordinates.
+ *
+ * With a pair table, indices falling in the same block are consumed two at a time and only the ones left
+ * without a partner are taken from the single-point table.
+ *
+ * @param table The public table of the level (see ESEM_Load_Table).
+ * @param hashOutput The hash of x under the level's key.
+ * @param RVerify The resulting point (X,Y,Z,Ta,Tb).
+ */
+static void ESEM_Server_Sum_Hashed(const esem_table_t *table, const unsigned char hashOutput[ESEM_HASH_BYTES], point_extproj_t RVerify)
+{
+    int pending[BPV_N/ESEM_TABLE_BLOCK];
+    unsigned int i, index, blk, local, base = ESEM_PAIR_INDEX(0, table->block);
+    int empty = 1;
+
+    if (table->mode == ESEM_TABLE_NONE) {
+        for (i = 0; i < BPV_V; ++i) {
+            ESEM_Accumulate(table->publicPre[BPV_INDEX(hashOutput, i)], RVerify, &empty);   // Add the R[i]'s and compute the final R
+        }
+        return;
+    }
+
+    for (i = 0; i < BPV_N/table->block; i++) {
+        pending[i] = -1;
+    }
+    for (i = 0; i < BPV_V; ++i) {
+        index = BPV_INDEX(hashOutput, i);
+        blk = index/table->block;
+        local = index%table->block;
+        if (pending[blk] < 0) {
+            pending[blk] = local;          // Wait for a partner in the same block
+        } else if ((unsigned int)pending[blk] <= local) {
+            ESEM_Accumulate(table->pairs[blk*base + ESEM_PAIR_INDEX(pending[blk], local)], RVerify, &empty);
+            pending[blk] = -1;
+        } else {
+            ESEM_Accumulate(table->pairs[blk*base + ESEM_PAIR_INDEX(local, pending[blk])], RVerify, &empty);
+            pending[blk] = -1;
+        }
+    }
+    for (i = 0; i < BPV_N/table->block; i++) {
+        if (pending[i] >= 0) {
+            ESEM_Accumulate(table->publicPre[i*table->block + pending[i]], RVerify, &empty);
+        }
+    }
+}
+
+
+typedef struct {
+    zmq_msg_t identity;                    // Envelope of the verifier, added by the ROUTER
+    int level;
+    unsigned char randValue[16];
+} esem_job_t;
+
+
+static void ESEM_Server_Sum_x4(const esem_server_t *server, const int *level, const unsigned char *const *randValue, unsigned int n, point_extproj_t *R)
+{ // ESEM_Server_Sum_Hashed of n <= 4 requests, whose hashes are computed together
+    unsigned char hashOutput[4][ESEM_HASH_BYTES];
+    unsigned char *out[4];
+    const unsigned char *in[4];
+    const blake2b_midstate_t *state[4];
+    unsigned int i, j;
+
+    for (i = 0; i < 4; i++) {              // Spare lanes repeat the first request
+        j = (i < n) ? i : 0;
+        out[i] = hashOutput[i];
+        in[i] = randValue[j];
+        state[i] = &server->levelKey[level[j]];
+    }
+    blake2b_midstate_hash_x4(state, out, in, 16);
+
+    for (i = 0; i < n; i++) {
+        ESEM_Server_Sum_Hashed(&server->table[level[i]], hashOutput[i], R[i]);
+    }
+}
+
+
+size_t ESEM_Server_Size(esem_table_mode_t mode)
+{
+    return ESEM_ARENA_SLACK(sizeof(esem_server_t)) + ESEM_L*(ESEM_ARENA_SLACK(BPV_N*sizeof(point_precomp_t)) + ESEM_ARENA_SLACK(ESEM_Table_Pairs(mode)*sizeof(point_precomp_t)));
+}
+
+
+/**
+ * Sets up a server: converts the l public tables into precomputed points (see ESEM_Load_Table) and absorbs the
+ * hashing keys. Everything is carved out of the arena, which needs ESEM_Server_Size(mode) bytes.
+ *
+ * @param arena The arena to carve the server out of.
+ * @param publicAll_1 The first public table.
+ * @param publicAll_2 The second public table.
+ * @param publicAll_3 The third public table.
+ * @param tempKey1 The first hashing key.
+ * @param tempKey2 The second hashing key.
+ * @param tempKey3 The third hashing key.
+ * @param mode The precomputation of the public tables, trading memory for fewer additions per request.
+ * @return esem_server_t* The server, or NULL if the arena is exhausted.
+ */
+esem_server_t *ESEM_Server_New(esem_arena_t *arena, const unsigned char *publicAll_1, const unsigned char *publicAll_2, const unsigned char *publicAll_3, const unsigned char tempKey1[32], const unsigned char tempKey2[32], const unsigned char tempKey3[32], esem_table_mode_t mode)
+{
+    const unsigned char *publicAll[ESEM_L] = {publicAll_1, publicAll_2, publicAll_3};
+    esem_server_t *server = ESEM_Arena_Alloc(arena, sizeof(esem_server_t));
+    unsigned int l;
+
+    if (server == NULL) {
+        return NULL;
+    }
+    for (l = 0; l < ESEM_L; l++) {
+        if (ESEM_Load_Table(arena, publicAll[l], mode, &server->table[l]) != ECCRYPTO_SUCCESS) {
+            return NULL;
+        }
+    }
+    blake2b_midstate_init(&server->levelKey[0], tempKey1, ESEM_HASH_BYTES, 32);
+    blake2b_midstate_init(&server->levelKey[1], tempKey2, ESEM_HASH_BYTES, 32);
+    blake2b_midstate_init(&server->levelKey[2], tempKey3, ESEM_HASH_BYTES, 32);
+
+    return server;
+}
+
+
+/**
+ * Computes one server's share of R: the sum of the BPV_V table points selected by x.
+ *
+ * @param server The server, see ESEM_Server_New.
+ * @param level The level of the request.
+ * @param randValue The 16-byte x from the signature.
+ * @param lastPublic The buffer to store the resulting 64-byte affine point.
+ * @return ECCRYPTO_STATUS ECCRYPTO_ERROR_INVALID_PARAMETER if there is no such level.
+ */
+ECCRYPTO_STATUS ESEM_Server_Respond(const esem_server_t *server, unsigned int level, const unsigned char randValue[16], unsigned char lastPublic[64])
+{
+    unsigned char hashOutput[ESEM_HASH_BYTES];
+    point_extproj_t RVerify;
+
+    if (level >= ESEM_L) {
+        return ECCRYPTO_ERROR_INVALID_PARAMETER;
+    }
+    blake2b_midstate_hash(&server->levelKey[level], hashOutput, randValue, 16);
+    ESEM_Server_Sum_Hashed(&server->table[level], hashOutput, RVerify);
+    eccnorm(RVerify, (point_affine*)lastPublic);
+
+    return ECCRYPTO_SUCCESS;
+}
+
+
+/**
+ * Answers count requests at once. The level hashes are computed four at a time and the points of each group of
+ * ESEM_BATCH_SIZE requests share one inversion.
+ *
+ * @param server The server, see ESEM_Server_New.
+ * @param entries The count requests level || x, ESEM_BATCH_ENTRY_BYTES each, as in a batch request.
+ * @param count The number of requests.
+ * @param points The buffer to store the count 64-byte points, in the same order.
+ * @return ECCRYPTO_STATUS ECCRYPTO_ERROR_INVALID_PARAMETER if some request names no level.
+ */
+ECCRYPTO_STATUS ESEM_Server_Respond_batch(const esem_server_t *server, const unsigned char *entries, unsigned int count, unsigned char *points)
+{
+    point_extproj_t R[ESEM_BATCH_SIZE];
+    point_t lastPublic[ESEM_BATCH_SIZE];
+    const unsigned char *randValue[4];
+    int level[4];
+    unsigned int i, j, k, n, m;
+
+    for (i = 0; i < count; i++) {
+        if (entries[i*ESEM_BATCH_ENTRY_BYTES] >= ESEM_L) {
+            return ECCRYPTO_ERROR_INVALID_PARAMETER;
+        }
+    }
+
+    for (i = 0; i < count; i += n) {
+        n = (count - i < ESEM_BATCH_SIZE) ? count - i : ESEM_BATCH_SIZE;
+        for (j = 0; j < n; j += m) {
+            m = (n - j < 4) ? n - j : 4;
+            for (k = 0; k < m; k++) {
+                level[k] = entries[(i + j + k)*ESEM_BATCH_ENTRY_BYTES];
+                randValue[k] = entries + (i + j + k)*ESEM_BATCH_ENTRY_BYTES + 1;
+            }
+            ESEM_Server_Sum_x4(server, level, randValue, m, &R[j]);
+        }
+        eccnorm_batch(R, lastPublic, n);
+        memcpy(points + i*ESEM_RESPONSE_BYTES, lastPublic, n*ESEM_RESPONSE_BYTES);
+    }
+
+    return ECCRYPTO_SUCCESS;
+}
+
+
+static double ESEM_Now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000.0 + ts.tv_nsec/1000000.0;
+}
+
+
+static int ESEM_More(void *socket)
+{ // Whether the message being received has more frames
+    int more = 0;
+    size_t len = sizeof(more);
+
+    return zmq_getsockopt(socket, ZMQ_RCVMORE, &more, &len) == 0 && more;
+}
+
+
+static void ESEM_Drain(void *socket)
+{ // Discards the frames left of the message being received
+    zmq_msg_t frame;
+    int rc;
+
+    while (ESEM_More(socket)) {
+        zmq_msg_init(&frame);
+        rc = zmq_msg_recv(&frame, socket, 0);
+        zmq_msg_close(&frame);
+        if (rc < 0) {
+            return;
+        }
+    }
+}
+
+
+static int ESEM_Recv_Job(void *socket, esem_job_t *job, zmq_msg_t *payload)
+{ // Reads one [identity][empty][request] message from the DEALER. Returns 0 for a single request, 1 for anything
+  // else, in which case the caller owns the received payload, 2 if the message was not framed that way and was
+  // dropped, or -1 once the context is terminated
+    zmq_msg_t delimiter;
+    int valid, terminated;
+
+    errno = 0;
+    zmq_msg_init(&job->identity);
+    if (zmq_msg_recv(&job->identity, socket, 0) < 0) {
+        zmq_msg_close(&job->identity);
+        return (zmq_errno() == ETERM) ? -1 : 2;
+    }
+    zmq_msg_init(&delimiter);
+    zmq_msg_init(payload);
+    valid = ESEM_More(socket) && zmq_msg_recv(&delimiter, socket, 0) == 0 &&
+            ESEM_More(socket) && zmq_msg_recv(payload, socket, 0) >= 0 && !ESEM_More(socket);
+    zmq_msg_close(&delimiter);
+    if (!valid) {
+        terminated = (zmq_errno() == ETERM);
+        ESEM_Drain(socket);
+        zmq_msg_close(payload);
+        zmq_msg_close(&job->identity);
+        return terminated ? -1 : 2;
+    }
+    job->level = ESEM_Parse_Request(zmq_msg_data(payload), zmq_msg_size(payload), job->randValue);
+    if (job->level < 0) {
+        return 1;
+    }
+    zmq_msg_close(payload);
+
+    return 0;
+}
+
+
+static void ESEM_Send_Envelope(void *socket, esem_job_t *job)
+{ // Sends the envelope routing a reply back through the DEALER, then releases it
+    zmq_msg_send(&job->identity, socket, ZMQ_SNDMORE);
+    zmq_send(socket, NULL, 0, ZMQ_SNDMORE);
+    zmq_msg_close(&job->identity);
+}
+
+
+static void ESEM_Send_Reply(void *socket, esem_job_t *job, const unsigned char *reply, size_t len)
+{ // Routes a reply back using the job's envelope
+    ESEM_Send_Envelope(socket, job);
+    zmq_send(socket, reply, len, 0);
+}
+
+
+static void ESEM_Serve_Batch(esem_server_t *server, void *socket, esem_job_t *job, zmq_msg_t *payload)
+{ // Answers a batch request in one reply, whose points are written straight into the outgoing message. Malformed
+  // requests get an empty reply
+    const unsigned char *request = zmq_msg_data(payload);
+    size_t len = zmq_msg_size(payload);
+    unsigned int count = 0;
+    zmq_msg_t reply;
+
+    if (len >= ESEM_BATCH_HEADER_BYTES && request[0] == CMD_REQUEST_VERIFICATION_BATCH) {
+        count = request[1] | (request[2] << 8);
+    }
+    if (count == 0 || count > ESEM_BATCH_MAX || len != ESEM_BATCH_HEADER_BYTES + (size_t)count*ESEM_BATCH_ENTRY_BYTES ||
+        zmq_msg_init_size(&reply, count*ESEM_RESPONSE_BYTES) != 0) {
+        ESEM_Send_Reply(socket, job, NULL, 0);
+        zmq_msg_close(payload);
+        return;
+    }
+
+    ESEM_Send_Envelope(socket, job);
+    if (ESEM_Server_Respond_batch(server, request + ESEM_BATCH_HEADER_BYTES, count, zmq_msg_data(&reply)) != ECCRYPTO_SUCCESS) {
+        zmq_msg_close(&reply);
+        zmq_msg_init(&reply);
+    }
+    zmq_msg_send(&reply, socket, 0);
+    zmq_msg_close(&reply);
+    zmq_msg_close(payload);
+}
+
+
+static void ESEM_Flush_Batch(esem_server_t *server, void *socket, esem_job_t *jobs, unsigned int n)
+{ // Aggregates the pending jobs and shares the final inversion among them
+    point_extproj_t R[ESEM_BATCH_SIZE];
+    point_t lastPublic[ESEM_BATCH_SIZE];
+    const unsigned char *randValue[4];
+    int level[4];
+    unsigned int i, j, m;
+
+    for (i = 0; i < n; i += m) {
+        m = (n - i < 4) ? n - i : 4;
+        for (j = 0; j < m; j++) {
+            level[j] = jobs[i + j].level;
+            randValue[j] = jobs[i + j].randValue;
+        }
+        ESEM_Server_Sum_x4(server, level, randValue, m, &R[i]);
+    }
+    eccnorm_batch(R, lastPublic, n);
+
+    for (i = 0; i < n; i++) {
+        ESEM_Send_Reply(socket, &jobs[i], (unsigned char*)lastPublic[i], ESEM_RESPONSE_BYTES);
+    }
+}
+
+
+static void *ESEM_Server_Worker(void *arg)
+{ // Worker thread: collects up to ESEM_BATCH_SIZE jobs or waits ESEM_BATCH_DEADLINE_MS, whichever comes first,
+  // then answers them together. Runs until the context is terminated
+    esem_server_t *server = (esem_server_t*)arg;
+    esem_job_t jobs[ESEM_BATCH_SIZE];
+    zmq_msg_t payload;
+    unsigned int pending = 0;
+    double deadline = 0;
+    long timeout;
+    int rc;
+
+    void *responder = zmq_socket(server->context, ZMQ_DEALER);
+    if (zmq_connect(responder, ESEM_WORKER_ENDPOINT) != 0) {
+        zmq_close(responder);
+        return NULL;
+    }
+    zmq_pollitem_t items[] = { { responder, 0, ZMQ_POLLIN, 0 } };
+
+    while (1) {
+        timeout = -1;
+        if (pending > 0) {
+            timeout = (long)(deadline - ESEM_Now_ms());
+            if (timeout < 0) {
+                timeout = 0;
+            }
+        }
+        if (zmq_poll(items, 1, timeout) < 0) {
+            if (zmq_errno() == ETERM) {
+                break;
+            }
+            continue;                      // Interrupted
+        }
+
+        if (items[0].revents & ZMQ_POLLIN) {
+            rc = ESEM_Recv_Job(responder, &jobs[pending], &payload);
+            if (rc < 0) {
+                break;                     // ETERM
+            }
+            if (rc == 1) {
+                ESEM_Serve_Batch(server, responder, &jobs[pending], &payload);   // Batch or malformed request, answered right away
+            } else if (rc == 0 && pending++ == 0) {   // rc == 2: malformed envelope, dropped as it cannot be routed back
+                deadline = ESEM_Now_ms() + ESEM_BATCH_DEADLINE_MS;
+            }
+        }
+
+        if (pending == ESEM_BATCH_SIZE || (pending > 0 && ESEM_Now_ms() >= deadline)) {
+            ESEM_Flush_Batch(server, responder, jobs, pending);
+            pending = 0;
+        }
+    }
+
+    while (pending > 0) {
+        zmq_msg_close(&jobs[--pending].identity);
+    }
+    zmq_close(responder);
+    return NULL;
+}
+
+
+/**
+ * Binds the ROUTER socket of a server, for ESEM_Server_Pool to serve on. The endpoint may leave the port to the
+ * system, as "tcp://127.0.0.1:*" does, so the endpoint actually bound is returned for the verifiers to connect to.
+ *
+ * @param server The server, see ESEM_Server_New.
+ * @param endpoint The zmq endpoint to bind to.
+ * @param bound The buffer to store the endpoint bound to, or NULL.
+ * @param bound_bytes The size of bound, ESEM_ENDPOINT_BYTES is enough.
+ * @return ECCRYPTO_STATUS ECCRYPTO_SUCCESS, ECCRYPTO_ERROR_INVALID_PARAMETER if the server is bound already,
+ *         ECCRYPTO_ERROR if the socket cannot be bound or bound is too small.
+ */
+ECCRYPTO_STATUS ESEM_Server_Bind(esem_server_t *server, const char *endpoint, char *bound, size_t bound_bytes)
+{
+    size_t length = bound_bytes;
+
+    if (server->frontend != NULL) {
+        return ECCRYPTO_ERROR_INVALID_PARAMETER;
+    }
+    server->context = zmq_ctx_new();
+    if (server->context == NULL) {
+        return ECCRYPTO_ERROR;
+    }
+    server->frontend = zmq_socket(server->context, ZMQ_ROUTER);
+    if (server->frontend == NULL || zmq_bind(server->frontend, endpoint) != 0 ||
+        (bound != NULL && zmq_getsockopt(server->frontend, ZMQ_LAST_ENDPOINT, bound, &length) != 0)) {
+        if (server->frontend != NULL) {
+            zmq_close(server->frontend);
+            server->frontend = NULL;
+        }
+        zmq_ctx_term(server->context);
+        server->context = NULL;
+        return ECCRYPTO_ERROR;
+    }
+
+    return ECCRYPTO_SUCCESS;
+}
+
+
+/**
+ * Persistent multi-threaded ESEM server.
+ *
+ * A ROUTER socket bound by ESEM_Server_Bind, or to ESEM_SERVER_ENDPOINT if it was not called, accepts requests from any number of verifiers and a DEALER
+ * spreads them across nworkers threads. The l levels are served by the same process: each request names
+ * the level it is for. Under load every worker answers its pending requests in batches that share a
+ * single inversion; a lone request is answered after at most ESEM_BATCH_DEADLINE_MS. Verifiers can also
+ * send up to ESEM_BATCH_MAX x-values in one CMD_REQUEST_VERIFICATION_BATCH message. The workers share the
+ * server's tables and only read them. The function only returns if the sockets cannot be set up or the
+ * context is terminated.
+ *
+ * @param server The server, see ESEM_Server_New.
+ * @param nworkers The number of worker threads, at most ESEM_SERVER_MAX_WORKERS.
+ * @return ECCRYPTO_STATUS The status of the server.
+ */
+ECCRYPTO_STATUS ESEM_Server_Pool(esem_server_t *server, unsigned int nworkers)
+{
+    ECCRYPTO_STATUS Status = ECCRYPTO_SUCCESS;
+    pthread_t workers[ESEM_SERVER_MAX_WORKERS];
+    unsigned int i, started = 0;
+
+    if (nworkers == 0 || nworkers > ESEM_SERVER_MAX_WORKERS) {
+        return ECCRYPTO_ERROR_INVALID_PARAMETER;
+    }
+    if (server->frontend == NULL && (Status = ESEM_Server_Bind(server, ESEM_SERVER_ENDPOINT, NULL, 0)) != ECCRYPTO_SUCCESS) {
+        return Status;
+    }
+
+    void *frontend = server->frontend;
+    void *backend = zmq_socket(server->context, ZMQ_DEALER);
+    if (zmq_bind(backend, ESEM_WORKER_ENDPOINT) != 0) {
+        Status = ECCRYPTO_ERROR;
+        goto cleanup;
+    }
+
+    for (i = 0; i < nworkers; i++) {
+        if (pthread_create(&workers[i], NULL, ESEM_Server_Worker, server) != 0) {
+            Status = ECCRYPTO_ERROR;
+            goto cleanup;
+        }
+        started++;
+    }
+
+    zmq_proxy(frontend, backend, NULL);    // Runs until the context is terminated
+
+cleanup:
+    zmq_close(frontend);
+    zmq_close(backend);
+    zmq_ctx_shutdown(server->context);     // Unblocks the workers
+    for (i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    zmq_ctx_term(server->context);
+    server->context = NULL;
+    server->frontend = NULL;
+
+    return Status;
+}
+
+
+static ECCRYPTO_STATUS ESEM_Send_Batch(void *requester, const unsigned char *levels, const unsigned char *randValues, unsigned int count)
+{ // Sends a CMD_REQUEST_VERIFICATION_BATCH message, the reply is the count points in the same order
+    unsigned char *request;
+    unsigned int i;
+    zmq_msg_t msg;
+
+    if (count == 0 || count > ESEM_BATCH_MAX) {
+        return ECCRYPTO_ERROR_INVALID_PARAMETER;
+    }
+    if (zmq_msg_init_size(&msg, ESEM_BATCH_HEADER_BYTES + count*ESEM_BATCH_ENTRY_BYTES) != 0) {
+        return ECCRYPTO_ERROR;
+    }
+    request = zmq_msg_data(&msg);          // Written in place, zmq sends it without another copy
+
+    request[0] = CMD_REQUEST_VERIFICATION_BATCH;
+    request[1] = count & 0xFF;
+    request[2] = count >> 8;
+    for (i = 0; i < count; i++) {
+        request[ESEM_BATCH_HEADER_BYTES + i*ESEM_BATCH_ENTRY_BYTES] = levels[i];
+        memcpy(request + ESEM_BATCH_HEADER_BYTES + i*ESEM_BATCH_ENTRY_BYTES + 1, randValues + 16*i, 16);
+    }
+
+    if (zmq_msg_send(&msg, requester, 0) < 0) {
+        zmq_msg_close(&msg);
+        return ECCRYPTO_ERROR;
+    }
+
+    return ECCRYPTO_SUCCESS;
+}
+
+
+/**
+ * Requests the points of count (level, x) pairs from a server in a single batch message.
+ *
+ * @param requester A REQ socket connected to the server.
+ * @param levels The count levels.
+ * @param randValues The count 16-byte x-values, concatenated.
+ * @param count The number of pairs, at most ESEM_BATCH_MAX.
+ * @param points The buffer to store the count 64-byte points, in the same order.
+ * @return ECCRYPTO_STATUS The status of the request.
+ */
+ECCRYPTO_STATUS ESEM_Request_Batch(void *requester, const unsigned char *levels, const unsigned char *randValues, unsigned int count, unsigned char *points)
+{
+    ECCRYPTO_STATUS Status = ESEM_Send_Batch(requester, levels, randValues, count);
+
+    if (Status == ECCRYPTO_SUCCESS && zmq_recv(requester, points, count*ESEM_RESPONSE_BYTES, 0) != (int)(count*ESEM_RESPONSE_BYTES)) {
+        Status = ECCRYPTO_ERROR;
+    }
+
+    return Status;
+}
+
+
+size_t ESEM_Verifier_Size(unsigned int max_batch)
+{
+    size_t size = ESEM_ARENA_SLACK(sizeof(esem_verifier_t)) + ESEM_ARENA_SLACK(ESEM_KEY_CACHE_ENTRIES*NPOINTS_CACHED_TABLE*sizeof(point_precomp_t)) +
+                  ESEM_ARENA_SLACK(ESEM_CHECKED_KEY_ENTRIES*sizeof(esem_checked_key_t));
+
+    if (max_batch > 0) {
+        size += ESEM_ARENA_SLACK(ESEM_L*max_batch) + ESEM_ARENA_SLACK(16*max_batch) + ESEM_ARENA_SLACK(ESEM_L*max_batch*ESEM_RESPONSE_BYTES) +
+                ESEM_ARENA_SLACK(max_batch*sizeof(point_extproj_t)) + ESEM_ARENA_SLACK(2*max_batch*sizeof(point_t)) +
+                ESEM_ARENA_SLACK(2*max_batch*NWORDS_ORDER*sizeof(digit_t)) + ESEM_ARENA_SLACK(max_batch*NWORDS_ORDER*sizeof(digit_t)) +
+                ESEM_ARENA_SLACK(ecc_mul_multi_scratch_bytes(2*max_batch));
+    }
+    return size;
+}
+
+
+static ECCRYPTO_STATUS ESEM_Verifier_Connect(esem_verifier_t *verifier)
+{ // (Re)opens the REQ sockets. A REQ socket whose request went unanswered cannot send again, so after a failure
+  // the sockets are replaced, which also drops any late reply
+    int timeout = ESEM_VERIFIER_TIMEOUT_MS, linger = 0;
+    unsigned int level;
+
+    for (level = 0; level < ESEM_L; level++) {
+        if (verifier->requester[level] != NULL) {
+            zmq_close(verifier->requester[level]);
+        }
+        verifier->requester[level] = zmq_socket(verifier->context, ZMQ_REQ);
+        if (verifier->requester[level] == NULL) {
+            return ECCRYPTO_ERROR;
+        }
+        zmq_setsockopt(verifier->requester[level], ZMQ_RCVTIMEO, &timeout, sizeof(timeout));
+        zmq_setsockopt(verifier->requester[level], ZMQ_LINGER, &linger, sizeof(linger));
+        if (zmq_connect(verifier->requester[level], verifier->endpoint[level]) != 0) {
+            return ECCRYPTO_ERROR;
+        }
+    }
+    return ECCRYPTO_SUCCESS;
+}
+
+
+/**
+ * Sets up a verifier: a REQ socket per server, kept open across verifications, the public key caches and the
+ * scratch buffers of ESEM_Verify_batch, all but the sockets carved out of the arena, which needs
+ * ESEM_Verifier_Size(max_batch) bytes.
+ *
+ * @param arena The arena to carve the verifier out of.
+ * @param max_batch The most signatures ESEM_Verify_batch will be given at once, at most ESEM_BATCH_MAX.
+ * @param endpoints The endpoint of the server of each level, shorter than ESEM_ENDPOINT_BYTES.
+ * @return esem_verifier_t* The verifier, to be released with ESEM_Verifier_Done, or NULL if the arena is exhausted
+ *         or the sockets cannot be set up.
+ */
+esem_verifier_t *ESEM_Verifier_New_Endpoints(esem_arena_t *arena, unsigned int max_batch, const char *const endpoints[ESEM_L])
+{
+    esem_verifier_t *verifier;
+    point_precomp_t *tables;
+    unsigned int i, level;
+
+    if (max_batch > ESEM_BATCH_MAX) {
+        return NULL;
+    }
+    for (level = 0; level < ESEM_L; level++) {
+        if (strlen(endpoints[level]) >= ESEM_ENDPOINT_BYTES) {
+            return NULL;
+        }
+    }
+    verifier = ESEM_Arena_Alloc(arena, sizeof(esem_verifier_t));
+    tables = ESEM_Arena_Alloc(arena, ESEM_KEY_CACHE_ENTRIES*NPOINTS_CACHED_TABLE*sizeof(point_precomp_t));
+    if (verifier == NULL || tables == NULL) {
+        return NULL;
+    }
+    for (level = 0; level < ESEM_L; level++) {
+        strcpy(verifier->endpoint[level], endpoints[level]);
+    }
+    verifier->checked = ESEM_Arena_Alloc(arena, ESEM_CHECKED_KEY_ENTRIES*sizeof(esem_checked_key_t));   // Zeroed, so all free
+    if (verifier->checked == NULL) {
+        return NULL;
+    }
+    for (i = 0; i < ESEM_KEY_CACHE_ENTRIES; i++) {
+        verifier->entry[i].table = tables + i*NPOINTS_CACHED_TABLE;
+    }
+
+    verifier->max_batch = max_batch;
+    if (max_batch > 0) {
+        verifier->levels = ESEM_Arena_Alloc(arena, ESEM_L*max_batch);
+        verifier->randValues = ESEM_Arena_Alloc(arena, 16*max_batch);
+        verifier->public_values = ESEM_Arena_Alloc(arena, ESEM_L*max_batch*ESEM_RESPONSE_BYTES);
+        verifier->RVerify = ESEM_Arena_Alloc(arena, max_batch*sizeof(point_extproj_t));
+        verifier->points = ESEM_Arena_Alloc(arena, 2*max_batch*sizeof(point_t));
+        verifier->scalars = ESEM_Arena_Alloc(arena, 2*max_batch*NWORDS_ORDER*sizeof(digit_t));
+        verifier->h = ESEM_Arena_Alloc(arena, max_batch*NWORDS_ORDER*sizeof(digit_t));
+        verifier->msm_bytes = ecc_mul_multi_scratch_bytes(2*max_batch);   // The most points ESEM_Verify_batch combines
+        verifier->msm = (verifier->msm_bytes > 0) ? ESEM_Arena_Alloc(arena, verifier->msm_bytes) : NULL;
+        if (verifier->levels == NULL || verifier->randValues == NULL || verifier->public_values == NULL || verifier->RVerify == NULL ||
+            verifier->points == NULL || verifier->scalars == NULL || verifier->h == NULL || (verifier->msm_bytes > 0 && verifier->msm == NULL)) {
+            return NULL;
+        }
+        for (level = 0; level < ESEM_L; level++) {
+            memset(verifier->levels + level*max_batch, level, max_batch);
+        }
+    }
+
+    verifier->context = zmq_ctx_new();
+    if (verifier->context == NULL) {
+        return NULL;
+    }
+    if (ESEM_Verifier_Connect(verifier) != ECCRYPTO_SUCCESS) {
+        ESEM_Verifier_Done(verifier);
+        return NULL;
+    }
+
+    return verifier;
+}
+
+
+// Sets up a verifier connected to the servers in ESEM_VERIFIER_ENDPOINTS, see ESEM_Verifier_New_Endpoints
+esem_verifier_t *ESEM_Verifier_New(esem_arena_t *arena, unsigned int max_batch)
+{
+    const char *const endpoints[ESEM_L] = ESEM_VERIFIER_ENDPOINTS;
+
+    return ESEM_Verifier_New_Endpoints(arena, max_batch, endpoints);
+}
+
+
+// Closes the sockets of a verifier. Its arena blocks can be reused afterwards
+void ESEM_Verifier_Done(esem_verifier_t *verifier)
+{
+    unsigned int level;
+
+    for (level = 0; level < ESEM_L; level++) {
+        if (verifier->requester[level] != NULL) {
+            zmq_close(verifier->requester[level]);
+            verifier->requester[level] = NULL;
+        }
+    }
+    if (verifier->context != NULL) {
+        zmq_ctx_term(verifier->context);
+        verifier->context = NULL;
+    }
+}
+
+
+static bool ESEM_In_Subgroup(const unsigned char point[64])
+{ // Whether the point lies in the subgroup of order N: (392^-1 mod N)*(392*P) gives back P only then
+    point_t Q;
+
+    return ecc_mul((point_affine*)point, (digit_t*)ESEM_cofactor_inverse, Q, true) && memcmp(Q, point, 64) == 0;
+}
+
+
+static bool ESEM_Equal_Cofactored(point_extproj_t R, point_t V)
+{ // Whether R == 392*V, R being a multiple of the cofactor already: points that differ by a point of small order
+  // (a multiple of N*G) are taken as equal. Points of order N are equal only if they are the same point
+    point_extproj_t W;
+    f2elm_t a, b;
+    digit_t diff[4*NWORDS_FIELD];
+
+    point_setup(V, W);
+    cofactor_clearing(W);
+    fp2mul1271(R->x, W->z, a);                         // Compare (X1:Y1:Z1) and (X2:Y2:Z2) without inversions
+    fp2mul1271(W->x, R->z, b);
+    fp2sub1271(a, b, a);
+    mod1271(a[0]);
+    mod1271(a[1]);
+    memcpy(diff, a, sizeof(a));
+    fp2mul1271(R->y, W->z, a);
+    fp2mul1271(W->y, R->z, b);
+    fp2sub1271(a, b, a);
+    mod1271(a[0]);
+    mod1271(a[1]);
+    memcpy(diff + 2*NWORDS_FIELD, a, sizeof(a));
+
+    return is_zero_ct(diff, 4*NWORDS_FIELD);
+}
+
+
+/**
+ * Checks that a public key lies in the subgroup of order N, remembering the keys that do so that each is checked
+ * once. Keys are looked up in the set picked by the first byte of x and replace its free or least recently used
+ * entry. No table is built: ESEM_Verify_batch meets many keys once, and ecc_precomp_cached() would cost it three
+ * times the check and evict the tables of the keys ESEM_Verifier sees often.
+ *
+ * @param verifier The verifier.
+ * @param public_key The 64-byte public key.
+ * @return bool true if public_key is a point of order N.
+ */
+static bool ESEM_Key_Checked(esem_verifier_t *verifier, const unsigned char public_key[64])
+{
+    esem_checked_key_t *set = verifier->checked + (public_key[0] % (ESEM_CHECKED_KEY_ENTRIES/ESEM_CHECKED_KEY_WAYS))*ESEM_CHECKED_KEY_WAYS;
+    esem_checked_key_t *victim = &set[0];
+    unsigned int i;
+
+    for (i = 0; i < ESEM_CHECKED_KEY_WAYS; i++) {
+        if (set[i].last_used != 0 && memcmp(set[i].public_key, public_key, 64) == 0) {
+            set[i].last_used = ++verifier->clock;
+            return true;
+        }
+        if (set[i].last_used < victim->last_used) {
+            victim = &set[i];
+        }
+    }
+
+    if (ESEM_In_Subgroup(public_key) == false) {
+        return false;
+    }
+    memcpy(victim->public_key, public_key, 64);
+    victim->last_used = ++verifier->clock;
+
+    return true;
+}
+
+
+/**
+ * Returns the cached table of a public key, generating it on a miss into the free or least recently used entry.
+ * Keys are checked to lie in the subgroup of order N first, see ESEM_Key_Checked.
+ *
+ * @param verifier The verifier.
+ * @param public_key The 64-byte public key.
+ * @return point_precomp_t* The table, valid until the next call, or NULL if public_key is not a point of order N.
+ */
+static point_precomp_t *ESEM_Key_Table(esem_verifier_t *verifier, const unsigned char public_key[64])
+{
+    esem_key_entry_t *entry, *victim = &verifier->entry[0];
+    unsigned int i;
+
+    for (i = 0; i < ESEM_KEY_CACHE_ENTRIES; i++) {
+        entry = &verifier->entry[i];
+
+        if (entry->last_used != 0 && memcmp(entry->public_key, public_key, 64) == 0) {
+            entry->last_used = ++verifier->clock;
+            return entry->table;
+        }
+        if (entry->last_used < victim->last_used) {
+            victim = entry;                // Free entries come first, they are never used
+        }
+    }
+
+    if (ESEM_Key_Checked(verifier, public_key) == false || ecc_precomp_cached((point_affine*)public_key, victim->table) == false) {
+        victim->last_used = 0;
+        return NULL;
+    }
+    memcpy(victim->public_key, public_key, 64);
+    victim->last_used = ++verifier->clock;
+
+    return victim->table;
+}
+
+
+static bool ESEM_Mul_Double(esem_verifier_t *verifier, digit_t *s, const unsigned char public_key[64], digit_t *h, point_t R)
+{ // R = s*G + h*PK, with PK's table taken from the cache. Returns false if PK is not a point of order N
+    point_precomp_t *table = ESEM_Key_Table(verifier, public_key);
+
+    if (table == NULL) {
+        return false;
+    }
+    return ecc_mul_double_cached(s, table, h, R);
+}
+
+
+/**
+ * Verifies an ESEM signature.
+ *
+ * x is sent to the l servers at once, one socket each, and s*G + h*PK is computed while they answer, using
+ * the cached table of PK (see ESEM_Key_Table). The servers' points are added up in the order they arrive.
+ * PK must be a point of order N. The signature is valid if 392*R == 392*(s*G + h*PK), that is, R may differ from
+ * s*G + h*PK by a point of small order. ESEM_Verify_batch checks the same equation, so both always agree.
+ *
+ * @param verifier The verifier, see ESEM_Verifier_New.
+ * @param signature The 48-byte signature x || s.
+ * @param message The 32-byte message.
+ * @param public_key The signer's public key.
+ * @return ECCRYPTO_STATUS ECCRYPTO_SUCCESS if the signature is valid, ECCRYPTO_ERROR_SIGNATURE_VERIFICATION if it is not,
+ *         ECCRYPTO_ERROR if a server does not answer within ESEM_VERIFIER_TIMEOUT_MS.
+ */
+ECCRYPTO_STATUS ESEM_Verifier(esem_verifier_t *verifier, const unsigned char *signature, const unsigned char *message, const unsigned char public_key[64]){
+
+    ECCRYPTO_STATUS Status = ECCRYPTO_SUCCESS;
+
+    void **requester = verifier->requester;
+    zmq_pollitem_t items[ESEM_L];
+    unsigned char public_value[64];
+    unsigned char lastPublic_Verify[64];
+    unsigned char request[ESEM_REQUEST_BYTES];
+    int level, received = 0;
+    bool valid;
+
+
+    point_extproj_t TempExtproj;
+    point_extproj_precomp_t TempExtprojPre;
+    point_extproj_t RVerify;
+
+
+    request[0] = CMD_REQUEST_VERIFICATION;
+    memcpy(request + 2, signature, 16);
+
+    for (level = 0; level < ESEM_L; level++) {
+        request[1] = level;
+        if (zmq_send (requester[level], request, ESEM_REQUEST_BYTES, 0) != ESEM_REQUEST_BYTES) {
+            ESEM_Verifier_Connect(verifier);
+            return ECCRYPTO_ERROR;
+        }
+
+        items[level].socket = requester[level];
+        items[level].fd = 0;
+        items[level].events = ZMQ_POLLIN;
+        items[level].revents = 0;
+    }
+
+    unsigned char hashedMsg[32] = {0}; 
+    blake2b_32_32_16(hashedMsg, message, signature);
+
+    modulo_order((digit_t*)hashedMsg, (digit_t*)hashedMsg);
+
+
+    valid = ESEM_Mul_Double(verifier, (digit_t*)(signature+16), public_key, (digit_t*)hashedMsg, (point_affine*)lastPublic_Verify);
+
+    while (received < ESEM_L) {
+        if (zmq_poll (items, ESEM_L, ESEM_VERIFIER_TIMEOUT_MS) <= 0) {
+            ESEM_Verifier_Connect(verifier);
+            return ECCRYPTO_ERROR;
+        }
+
+        for (level = 0; level < ESEM_L; level++) {
+            if (!(items[level].revents & ZMQ_POLLIN)) {
+                continue;
+            }
+            if (zmq_recv (requester[level], public_value, 64, 0) != 64) {
+                ESEM_Verifier_Connect(verifier);
+                return ECCRYPTO_ERROR;
+            }
+            items[level].events = 0;        // Level answered, stop polling it
+
+            if (received++ == 0) {
+                point_setup((point_affine*)public_value, RVerify);
+            } else {
+                point_setup((point_affine*)public_value, TempExtproj);
+
+                R1_to_R2(TempExtproj, TempExtprojPre);
+                eccadd(TempExtprojPre, RVerify);   // Add the R[i]'s and compute the final R
+            }
+        }
+    }
+
+    cofactor_clearing(RVerify);
+    if (!valid || !ESEM_Equal_Cofactored(RVerify, (point_affine*)lastPublic_Verify))
+        Status = ECCRYPTO_ERROR_SIGNATURE_VERIFICATION;
+
+    return Status;
+
+}
+
+
+
+
+
+/**
+ * Verifies count ESEM signatures together.
+ *
+ * The l servers are asked for all the x-values in one batch message each, and the signatures are checked with a
+ * random linear combination: sum z_i*392*R_i + sum (-392*z_i*h_i)*PK_i == (392*sum z_i*s_i)*G for random 128-bit z_i,
+ * which costs one multi-scalar multiplication and one fixed-base multiplication. Clearing the cofactor of the R_i
+ * and checking that the PK_i have order N first keeps small-order points from cancelling out in the combination,
+ * so that the result is the one ESEM_Verifier gives. The keys found to have order N are remembered, but their
+ * tables are only built if some signature has to be checked on its own. Consecutive signatures by the same
+ * signer share their public key's term. If the combination does not hold, every signature is checked on its own
+ * to find the invalid ones.
+ *
+ * @param verifier The verifier, see ESEM_Verifier_New.
+ * @param signatures The count 48-byte signatures x || s, concatenated.
+ * @param messages The count 32-byte messages, concatenated.
+ * @param public_keys The count 64-byte public keys of the signers, concatenated.
+ * @param count The number of signatures, at most the max_batch the verifier was set up with.
+ * @param valid The buffer to store, for each signature, 1 if it is valid and 0 otherwise.
+ * @return ECCRYPTO_STATUS ECCRYPTO_SUCCESS if all the signatures are valid, ECCRYPTO_ERROR_SIGNATURE_VERIFICATION if some are not.
+ */
+ECCRYPTO_STATUS ESEM_Verify_batch(esem_verifier_t *verifier, const unsigned char *signatures, const unsigned char *messages, const unsigned char *public_keys, unsigned int count, int *valid)
+{
+    ECCRYPTO_STATUS Status = ECCRYPTO_SUCCESS;
+
+    void **requester = verifier->requester;
+    unsigned char *randValues = verifier->randValues, *public_values = verifier->public_values;
+    point_extproj_t *RVerify = verifier->RVerify, TempExtproj;
+    point_extproj_precomp_t TempExtprojPre;
+    point_t *points = verifier->points, lastPublic_Verify, sumG;
+    digit_t *scalars = verifier->scalars, *h = verifier->h;
+    digit_t z[NWORDS_ORDER], s[NWORDS_ORDER], zs[NWORDS_ORDER], mz[NWORDS_ORDER], mh[NWORDS_ORDER], zero[NWORDS_ORDER] = {0}, cofactor[NWORDS_ORDER] = {ESEM_COFACTOR};
+    unsigned int i, level, nkeys = 0;
+    bool keys_valid = true;
+
+    if (count == 0 || count > verifier->max_batch) {
+        return ECCRYPTO_ERROR_INVALID_PARAMETER;
+    }
+    memset(valid, 0, count*sizeof(int));
+
+    for (i = 0; i < count; i++) {
+        memcpy(randValues + 16*i, signatures + 48*i, 16);
+    }
+    for (level = 0; level < ESEM_L; level++) {
+        Status = ESEM_Send_Batch(requester[level], verifier->levels + level*verifier->max_batch, randValues, count);
+        if (Status != ECCRYPTO_SUCCESS) {
+            ESEM_Verifier_Connect(verifier);
+            return Status;
+        }
+    }
+
+    for (i = 0; i < count; i += 4) {       // Four message hashes at a time, spare lanes repeat the last one
+        unsigned char *out[4];
+        const unsigned char *in[4], *key[4];
+        unsigned char spare[32];
+        unsigned int j, k;
+
+        for (j = 0; j < 4; j++) {
+            k = (i + j < count) ? i + j : count - 1;
+            out[j] = (i + j < count) ? (unsigned char*)(h + k*NWORDS_ORDER) : spare;
+            in[j] = messages + 32*k;
+            key[j] = signatures + 48*k;
+        }
+        blake2b_32_32_16_x4(out, in, key);
+    }
+    for (i = 0; i < count; i++) {
+        modulo_order(h + i*NWORDS_ORDER, h + i*NWORDS_ORDER);
+    }
+
+    for (level = 0; level < ESEM_L; level++) {
+        unsigned char *public_value = public_values + level*count*ESEM_RESPONSE_BYTES;
+
+        if (zmq_recv (requester[level], public_value, count*ESEM_RESPONSE_BYTES, 0) != (int)(count*ESEM_RESPONSE_BYTES)) {
+            ESEM_Verifier_Connect(verifier);
+            return ECCRYPTO_ERROR;
+        }
+        for (i = 0; i < count; i++) {
+            if (level == 0) {
+                point_setup((point_affine*)(public_value + i*ESEM_RESPONSE_BYTES), RVerify[i]);
+            } else {
+                point_setup((point_affine*)(public_value + i*ESEM_RESPONSE_BYTES), TempExtproj);
+                R1_to_R2(TempExtproj, TempExtprojPre);
+                eccadd(TempExtprojPre, RVerify[i]);   // Add the R[i]'s and compute the final R
+            }
+        }
+    }
+    for (i = 0; i < count; i++) {
+        cofactor_clearing(RVerify[i]);                  // As in ESEM_Verifier, small-order parts of R_i are ignored
+    }
+    eccnorm_batch(RVerify, points, count);             // 392*R_i in points[0..count-1]
+
+    // Random linear combination
+    memset(zs, 0, sizeof(zs));
+    for (i = 0; i < count; i++) {
+        digit_t *k = scalars + i*NWORDS_ORDER, *l = scalars + (count+nkeys)*NWORDS_ORDER;
+
+        memset(z, 0, sizeof(z));
+        if (random_bytes((unsigned char*)z, 16) == false) {
+            return ECCRYPTO_ERROR;
+        }
+        memcpy(k, z, sizeof(z));                        // z_i
+
+        to_Montgomery(z, mz);
+        to_Montgomery(h + i*NWORDS_ORDER, mh);
+        Montgomery_multiply_mod_order(mz, mh, mh);
+        from_Montgomery(mh, s);
+        subtract_mod_order(zero, s, s);                 // -z_i*h_i
+        if (nkeys > 0 && memcmp(points[count+nkeys-1], public_keys + 64*i, 64) == 0) {
+            add_mod_order(l - NWORDS_ORDER, s, l - NWORDS_ORDER);   // Same signer as the previous signature: merge the scalars
+        } else {
+            memcpy(l, s, sizeof(s));
+            memcpy(points[count+nkeys], public_keys + 64*i, 64);
+            nkeys++;
+            keys_valid = keys_valid && ESEM_Key_Checked(verifier, public_keys + 64*i);   // PK_i of order N, without a table
+        }
+
+        modulo_order((digit_t*)(signatures + 48*i + 16), s);
+        to_Montgomery(s, mh);
+        Montgomery_multiply_mod_order(mz, mh, mh);
+        from_Montgomery(mh, s);
+        add_mod_order(zs, s, zs);                       // sum z_i*s_i
+    }
+    to_Montgomery(cofactor, mz);                        // The R_i were multiplied by the cofactor, so are the other terms
+    for (i = 0; i <= nkeys; i++) {
+        digit_t *l = (i < nkeys) ? scalars + (count+i)*NWORDS_ORDER : zs;
+
+        to_Montgomery(l, mh);
+        Montgomery_multiply_mod_order(mz, mh, mh);
+        from_Montgomery(mh, l);
+    }
+
+    if (keys_valid && ecc_mul_multi_scratch(points, scalars, count+nkeys, lastPublic_Verify, verifier->msm, verifier->msm_bytes) == true) {
+        ecc_mul_fixed(zs, sumG);
+        if (memcmp(lastPublic_Verify, sumG, 64) == 0) {
+            for (i = 0; i < count; i++) {
+                valid[i] = 1;
+            }
+            return ECCRYPTO_SUCCESS;
+        }
+    }
+
+    // Some signature is invalid, or some public key is not a point of order N: check them one by one
+    for (i = 0; i < count; i++) {
+        point_setup(points[i], TempExtproj);
+        valid[i] = ESEM_Mul_Double(verifier, (digit_t*)(signatures + 48*i + 16), public_keys + 64*i, h + i*NWORDS_ORDER, lastPublic_Verify) &&
+                   ESEM_Equal_Cofactored(TempExtproj, lastPublic_Verify);
+        if (!valid[i]) {
+            Status = ECCRYPTO_ERROR_SIGNATURE_VERIFICATION;
+        }
+    }
+
+    return Status;
+}
+
+
+/**************** Key store ****************/
+
+// Header of a store file, followed by page-aligned sections: the public tables, the secret tables if flags has
+// ESEM_STORE_SECRETS, and the server tables if flags has ESEM_STORE_PRECOMPUTED. The parameters must match the
+// build reading the file; integers are in host order (little endian on every supported target)
+typedef struct {
+    char magic[8];                         // ESEM_STORE_MAGIC
+    uint32_t version, flags;
+    uint32_t bpv_n, bpv_v, levels, hash_bytes;
+    uint32_t digit_bytes, point_bytes;     // sizeof(digit_t) and sizeof(point_precomp_t), the in-memory layout of the server tables
+    uint32_t mode, reserved;               // esem_table_mode_t of the server tables
+    uint64_t size;                         // File size
+    uint64_t publicAll, secretAll, precomputed;   // Section offsets, 0 if absent
+    unsigned char public_key[64];
+    unsigned char tempKey[ESEM_L][32];
+    unsigned char secret_key[32];          // Zero if the secrets are absent
+    unsigned char seed[32];                // Zero without ESEM_STORE_SEED
+} esem_store_header_t;
+
+struct esem_store {
+    const unsigned char *map;
+    size_t size;
+    const esem_store_header_t *header;
+};
+
+#define ESEM_STORE_ROUND(size)           (((size) + ESEM_STORE_ALIGN - 1) & ~(uint64_t)(ESEM_STORE_ALIGN - 1))
+
+
+static size_t ESEM_Store_Level_Bytes(esem_table_mode_t mode)
+{ // Server table bytes of one level: publicPre, then pairs
+    return (BPV_N + ESEM_Table_Pairs(mode))*sizeof(point_precomp_t);
+}
+
+
+static void ESEM_Store_Layout(esem_store_header_t *header, uint32_t flags, esem_table_mode_t mode)
+{ // Sets the parameters and section offsets of a header for a store with the given contents
+    uint64_t offset = ESEM_STORE_ROUND(sizeof(esem_store_header_t));
+
+    memcpy(header->magic, ESEM_STORE_MAGIC, 8);
+    header->version = ESEM_STORE_VERSION;
+    header->flags = flags;
+    header->bpv_n = BPV_N;
+    header->bpv_v = BPV_V;
+    header->levels = ESEM_L;
+    header->hash_bytes = ESEM_HASH_BYTES;
+    header->digit_bytes = sizeof(digit_t);
+    header->point_bytes = sizeof(point_precomp_t);
+    header->mode = (flags & ESEM_STORE_PRECOMPUTED) ? mode : ESEM_TABLE_NONE;
+    header->reserved = 0;
+
+    header->publicAll = offset;
+    offset += ESEM_STORE_ROUND(ESEM_L*BPV_N*64);
+    header->secretAll = 0;
+    if (flags & ESEM_STORE_SECRETS) {
+        header->secretAll = offset;
+        offset += ESEM_STORE_ROUND(ESEM_L*BPV_N*32);
+    }
+    header->precomputed = 0;
+    if (flags & ESEM_STORE_PRECOMPUTED) {
+        header->precomputed = offset;
+        offset += ESEM_STORE_ROUND(ESEM_L*ESEM_Store_Level_Bytes(mode));
+    }
+    header->size = offset;
+}
+
+
+static int ESEM_Store_Put(int fd, const void *data, size_t length, uint64_t offset)
+{ // Writes length bytes at offset, returns 0 on failure
+    const unsigned char *p = data;
+    ssize_t n;
+
+    while (length > 0) {
+        n = pwrite(fd, p, length, (off_t)offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return 0;
+        }
+        p += n;
+        offset += n;
+        length -= n;
+    }
+    return 1;
+}
+
+
+size_t ESEM_Store_Size(void)
+{
+    return ESEM_ARENA_SLACK(sizeof(esem_store_t));
+}
+
+
+/**
+ * Writes a key store, either for a signer or for its servers. A signer store holds the public tables and level keys
+ * together with the secret tables, secret key and seed if keys->secret_key (and keys->seed) is set. A server store
+ * is written when a server is given: it holds the public tables, the level keys and the precomputed server tables,
+ * so that servers started from it skip the precomputation, and never any secret. The file is created readable by
+ * its owner only, written next to path and renamed over it once synced, so processes that have the old file mapped
+ * keep a consistent view.
+ *
+ * @param path The store file.
+ * @param keys The keys to store. secretAll must be set if secret_key is.
+ * @param server A server set up from the same keys, or NULL.
+ * @return ECCRYPTO_STATUS The status of the writing, ECCRYPTO_ERROR_INVALID_PARAMETER if both keys->secret_key
+ *                         and server are given.
+ */
+ECCRYPTO_STATUS ESEM_Store_Write(const char *path, const esem_keys_t *keys, const esem_server_t *server)
+{
+    esem_store_header_t header;
+    char tmp[PATH_MAX];
+    uint32_t flags = 0;
+    unsigned int l;
+    int fd, ok = 1;
+
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp)) {
+        return ECCRYPTO_ERROR_INVALID_PARAMETER;
+    }
+    if (keys->secret_key != NULL && server != NULL) {
+        return ECCRYPTO_ERROR_INVALID_PARAMETER;   // Server stores are shared with the servers, they carry no secrets
+    }
+    if (keys->secret_key != NULL) {
+        flags |= ESEM_STORE_SECRETS;
+        if (keys->seed != NULL) {
+            flags |= ESEM_STORE_SEED;
+        }
+    }
+    if (server != NULL) {
+        flags |= ESEM_STORE_PRECOMPUTED;
+    }
+
+    memset(&header, 0, sizeof(header));
+    ESEM_Store_Layout(&header, flags, (server != NULL) ? server->table[0].mode : ESEM_TABLE_NONE);
+    memcpy(header.public_key, keys->public_key, 64);
+    for (l = 0; l < ESEM_L; l++) {
+        memcpy(header.tempKey[l], keys->tempKey[l], 32);
+    }
+    if (flags & ESEM_STORE_SECRETS) {
+        memcpy(header.secret_key, keys->secret_key, 32);
+    }
+    if (flags & ESEM_STORE_SEED) {
+        memcpy(header.seed, keys->seed, 32);
+    }
+
+    unlink(tmp);                                   // A stale file would keep its permissions
+    fd = open(tmp, O_WRONLY | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        return ECCRYPTO_ERROR;
+    }
+    ok = ESEM_Store_Put(fd, &header, sizeof(header), 0);
+    for (l = 0; l < ESEM_L && ok; l++) {
+        ok = ESEM_Store_Put(fd, keys->publicAll[l], BPV_N*64, header.publicAll + l*BPV_N*64);
+        if (ok && (flags & ESEM_STORE_SECRETS)) {
+            ok = ESEM_Store_Put(fd, keys->secretAll[l], BPV_N*32, header.secretAll + l*BPV_N*32);
+        }
+        if (ok && (flags & ESEM_STORE_PRECOMPUTED)) {
+            uint64_t offset = header.precomputed + l*ESEM_Store_Level_Bytes(server->table[l].mode);
+
+            ok = ESEM_Store_Put(fd, server->table[l].publicPre, BPV_N*sizeof(point_precomp_t), offset) &&
+                 ESEM_Store_Put(fd, server->table[l].pairs, ESEM_Table_Pairs(server->table[l].mode)*sizeof(point_precomp_t), offset + BPV_N*sizeof(point_precomp_t));
+        }
+    }
+    ok = ok && ftruncate(fd, (off_t)header.size) == 0 && fsync(fd) == 0;
+    ok = (close(fd) == 0) && ok;
+    if (!ok || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return ECCRYPTO_ERROR;
+    }
+
+    return ECCRYPTO_SUCCESS;
+}
+
+
+/**
+ * Maps a key store read-only. The pages are shared with every other process mapping the same file, and nothing is
+ * copied: the keys and server tables are used in place.
+ *
+ * @param arena The arena to carve the store handle out of, which needs ESEM_Store_Size() bytes.
+ * @param path The store file.
+ * @return esem_store_t* The store, or NULL if the file cannot be mapped, is truncated or was written with
+ *                       other parameters.
+ */
+esem_store_t *ESEM_Store_Open(esem_arena_t *arena, const char *path)
+{
+    esem_store_header_t expected;
+    const esem_store_header_t *header;
+    esem_store_t *store;
+    struct stat st;
+    void *map;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(esem_store_header_t)) {
+        close(fd);
+        return NULL;
+    }
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    // Everything but the keys must be what this build would have written
+    header = map;
+    memset(&expected, 0, sizeof(expected));
+    ESEM_Store_Layout(&expected, header->flags, (esem_table_mode_t)header->mode);
+    if (header->flags > (ESEM_STORE_SECRETS | ESEM_STORE_PRECOMPUTED | ESEM_STORE_SEED) || header->mode > ESEM_TABLE_BLOCKED ||
+        memcmp(header, &expected, offsetof(esem_store_header_t, public_key)) != 0 || header->size > (uint64_t)st.st_size) {
+        munmap(map, (size_t)st.st_size);
+        return NULL;
+    }
+
+    store = ESEM_Arena_Alloc(arena, sizeof(esem_store_t));
+    if (store == NULL) {
+        munmap(map, (size_t)st.st_size);
+        return NULL;
+    }
+    store->map = map;
+    store->size = (size_t)st.st_size;
+    store->header = header;
+
+    return store;
+}
+
+
+void ESEM_Store_Close(esem_store_t *store)
+{ // Servers and signers using the store's keys must be done with them
+    munmap((void*)store->map, store->size);
+    store->map = NULL;
+    store->header = NULL;
+}
+
+
+unsigned int ESEM_Store_Flags(const esem_store_t *store)
+{
+    return store->header->flags;
+}
+
+
+void ESEM_Store_Keys(const esem_store_t *store, esem_keys_t *keys)
+{
+    const esem_store_header_t *header = store->header;
+    unsigned int l;
+
+    keys->seed = (header->flags & ESEM_STORE_SEED) ? header->seed : NULL;
+    keys->secret_key = (header->flags & ESEM_STORE_SECRETS) ? header->secret_key : NULL;
+    keys->public_key = header->public_key;
+    for (l = 0; l < ESEM_L; l++) {
+        keys->tempKey[l] = header->tempKey[l];
+        keys->publicAll[l] = store->map + header->publicAll + l*BPV_N*64;
+        keys->secretAll[l] = (header->flags & ESEM_STORE_SECRETS) ? store->map + header->secretAll + l*BPV_N*32 : NULL;
+    }
+}
+
+
+/**
+ * Sets up a server from a key store. If the store holds precomputed tables the server points into the mapping and
+ * only the hashing keys are absorbed, so that start-up takes no time and every server process shares one copy of
+ * the tables. Otherwise this is ESEM_Server_New on the store's keys.
+ *
+ * @param arena The arena to carve the server out of: ESEM_Server_Size(ESEM_TABLE_NONE) bytes are enough if the
+ *              store holds precomputed tables, ESEM_Server_Size(mode) otherwise.
+ * @param store The key store.
+ * @param mode The precomputation used if the store holds none.
+ * @return esem_server_t* The server, or NULL if the arena is exhausted.
+ */
+esem_server_t *ESEM_Server_From_Store(esem_arena_t *arena, const esem_store_t *store, esem_table_mode_t mode)
+{
+    const esem_store_header_t *header = store->header;
+    esem_server_t *server;
+    esem_keys_t keys;
+    unsigned int l;
+
+    ESEM_Store_Keys(store, &keys);
+    if (!(header->flags & ESEM_STORE_PRECOMPUTED)) {
+        return ESEM_Server_New(arena, keys.publicAll[0], keys.publicAll[1], keys.publicAll[2], keys.tempKey[0], keys.tempKey[1], keys.tempKey[2], mode);
+    }
+
+    server = ESEM_Arena_Alloc(arena, sizeof(esem_server_t));
+    if (server == NULL) {
+        return NULL;
+    }
+    mode = (esem_table_mode_t)header->mode;
+    for (l = 0; l < ESEM_L; l++) {
+        // The tables are only read once loaded, so they can stay in the read-only mapping
+        point_precomp_t *publicPre = (point_precomp_t*)(store->map + header->precomputed + l*ESEM_Store_Level_Bytes(mode));
+
+        server->table[l].mode = mode;
+        server->table[l].block = (mode == ESEM_TABLE_PAIRS) ? BPV_N : ESEM_TABLE_BLOCK;
+        server->table[l].publicPre = publicPre;
+        server->table[l].pairs = (mode == ESEM_TABLE_NONE) ? NULL : publicPre + BPV_N;
+        blake2b_midstate_init(&server->levelKey[l], keys.tempKey[l], ESEM_HASH_BYTES, 32);
+    }
+
+    return server;
+}
@@ -0,0 +1,255 @@
+/***********************************************************************************
+* ESEM: Energy-Aware Signature for Embedded Medical Devices, on top of FourQlib
+*
+*    Licensed under CC BY-NC 4.0, see the Licensing section of README.md
+*
+* Abstract: API header file for the ESEM signature scheme (libesem)
+*
+* The signer, server and verifier contexts are opaque. Their storage, and the storage
+* of the key tables, is carved out of a single caller-supplied arena (see esem_arena_t),
+* so that signing, answering requests and verifying do not allocate memory. A context
+* may be used by one thread at a time; threads that sign or verify concurrently each
+* use their own context. A server context is read-only once created and is shared by
+* all threads answering requests.
+************************************************************************************/
+
+#ifndef __ESEM_H__
+#define __ESEM_H__
+
+
+// For C++
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include "FourQ_api.h"
+
+
+/**************** Parameters ****************/
+
+// ESEMv2 parameters unless built with HIGH_SPEED=0 (make HIGH_SPEED=FALSE) for the ESEMv1 ones. The library and the
+// programs using it must be built with the same value
+#ifndef HIGH_SPEED
+    #define HIGH_SPEED 1
+#endif
+
+#if HIGH_SPEED // This is ESEMv2
+    #define BPV_V             40
+    #define ESEM_L            3
+    #define BPV_N             128
+    #define ESEM_HASH_BYTES   40
+    #define BPV_INDEX(h, i)   ((h)[i]/2)                                    // Table entry picked by the i-th part of a level hash
+#else
+    #define BPV_V             18
+    #define ESEM_L            3
+    #define BPV_N             1024
+    #define ESEM_HASH_BYTES   36
+    #define BPV_INDEX(h, i)   ((h)[2*(i)] + (((h)[2*(i)+1]/64) * 256))
+#endif
+
+#define CMD_REQUEST_VERIFICATION         0x000010
+#define CMD_REQUEST_VERIFICATION_BATCH   0x000011
+
+// Verifier <-> server messages. A request is CMD_REQUEST_VERIFICATION || level || x,
+// the response is the 64-byte affine point aggregated from the requested level's table.
+#define ESEM_REQUEST_BYTES               18
+#define ESEM_RESPONSE_BYTES              64
+
+// A batch request is CMD_REQUEST_VERIFICATION_BATCH || K (2 bytes, little endian) || K x (level || x),
+// the response is the K points in the same order.
+#define ESEM_BATCH_HEADER_BYTES          3
+#define ESEM_BATCH_ENTRY_BYTES           17
+#define ESEM_BATCH_MAX                   4096
+
+#define ESEM_SERVER_ENDPOINT             "tcp://*:5555"
+#define ESEM_ENDPOINT_BYTES              256       // Longest endpoint, with its terminating zero, a verifier or ESEM_Server_Bind takes
+#define ESEM_WORKER_ENDPOINT             "inproc://esem-workers"
+#define ESEM_SERVER_MAX_WORKERS          64        // Most worker threads ESEM_Server_Pool starts
+#define ESEM_BATCH_SIZE                  32        // Jobs a worker collects before normalizing them together
+#define ESEM_BATCH_DEADLINE_MS           2         // Longest a pending job waits for the batch to fill up
+
+// Server of each level, as seen by the verifier. The three servers are simulated by a single one.
+#define ESEM_VERIFIER_ENDPOINTS          { "tcp://localhost:5555", "tcp://localhost:5555", "tcp://localhost:5555" }
+#define ESEM_VERIFIER_TIMEOUT_MS         5000
+#define ESEM_KEY_CACHE_ENTRIES           64        // Public keys whose ecc_precomp_cached() tables a verifier keeps, 24KB each
+#define ESEM_CHECKED_KEY_ENTRIES         1024      // Public keys a verifier remembers to have order N, 72 bytes each
+#define ESEM_CHECKED_KEY_WAYS            4         // Of them, keys sharing the first byte of x compete for this many entries
+
+#define ESEM_KEYGEN_THREADS              0         // Threads used by ESEM_KeyGen, 0 for one per online core
+#define ESEM_KEYGEN_MAX_THREADS          64        // Most threads ESEM_KeyGen_Seeded uses
+#define ESEM_KEYGEN_CHUNK                16        // Table entries a keygen thread takes at a time
+#define ESEM_OFFLINE_POOL                64        // (x, r) pairs an offline ESEMv2 signer keeps ready
+#define ESEM_SIGN_LANES                  4         // Signatures ESEM_Sign_batch computes together: one per BLAKE2b lane, so 4
+
+#define ESEM_ARENA_ALIGN                 64        // Alignment of every block carved out of an arena, one cache line
+
+// Server table precomputation (see ESEM_Server_New)
+typedef enum {
+    ESEM_TABLE_NONE,                       // BPV_N points, BPV_V additions per request
+    ESEM_TABLE_PAIRS,                      // Plus all BPV_N*(BPV_N+1)/2 pair sums, about BPV_V/2 additions per request
+    ESEM_TABLE_BLOCKED                     // Plus the pair sums inside blocks of ESEM_TABLE_BLOCK points
+} esem_table_mode_t;
+
+#define ESEM_TABLE_BLOCK                 16
+
+// Key store files (see ESEM_Store_Write)
+#define ESEM_STORE_MAGIC                 "ESEMKEYS"
+#define ESEM_STORE_VERSION               1
+#define ESEM_STORE_ALIGN                 4096      // Every section of a store starts on its own page
+#define ESEM_STORE_SECRETS               0x1       // The store holds secret_key and the secretAll tables
+#define ESEM_STORE_PRECOMPUTED           0x2       // The store holds the server tables in precomputed point form
+#define ESEM_STORE_SEED                  0x4       // The store holds the key generation seed, the ESEMv1 signing key
+
+
+/**************** Arenas and contexts ****************/
+
+// Caller-supplied memory that contexts and tables are carved out of, in blocks aligned to ESEM_ARENA_ALIGN bytes.
+// Nothing is ever given back: the caller releases the whole buffer once the contexts in it are done
+typedef struct {
+    unsigned char* base;
+    size_t size;
+    size_t used;
+} esem_arena_t;
+
+typedef struct esem_signer esem_signer_t;       // Expanded signing keys
+typedef struct esem_offline esem_offline_t;     // ESEMv2 signer with a pool of precomputed (x, r) pairs
+typedef struct esem_server esem_server_t;       // Precomputed public tables of the l levels
+typedef struct esem_verifier esem_verifier_t;   // Server connections, public key cache and batch scratch
+typedef struct esem_store esem_store_t;         // Read-only mapping of a key store file
+
+// The keys of a signer and of its servers, as written to or read from a key store
+typedef struct {
+    const unsigned char* seed;                  // 32 bytes, NULL if absent
+    const unsigned char* secret_key;            // 32 bytes, NULL if absent
+    const unsigned char* public_key;            // 64 bytes
+    const unsigned char* tempKey[ESEM_L];       // 32 bytes each
+    const unsigned char* publicAll[ESEM_L];     // BPV_N 64-byte points each
+    const unsigned char* secretAll[ESEM_L];     // BPV_N 32-byte secrets each, NULL if absent
+} esem_keys_t;
+
+// Sets up an arena over buffer[0..size-1]. The buffer need not be aligned
+void ESEM_Arena_Init(esem_arena_t* arena, void* buffer, size_t size);
+
+// Carves size bytes, aligned to ESEM_ARENA_ALIGN, out of the arena. Returns NULL if the arena is exhausted
+void* ESEM_Arena_Alloc(esem_arena_t* arena, size_t size);
+
+// Arena bytes taken by each object below, including the alignment slack, so that sizes can simply be added up
+size_t ESEM_Tables_Size(void);
+size_t ESEM_Signer_Size(void);
+size_t ESEM_Offline_Size(void);
+size_t ESEM_Server_Size(esem_table_mode_t mode);
+size_t ESEM_Verifier_Size(unsigned int max_batch);
+size_t ESEM_Store_Size(void);
+
+// Carves the six key tables out of the arena, back to back: publicAll[l] holds BPV_N 64-byte points and secretAll[l]
+// BPV_N 32-byte secrets, for l < ESEM_L
+ECCRYPTO_STATUS ESEM_Tables_New(esem_arena_t* arena, unsigned char* publicAll[ESEM_L], unsigned char* secretAll[ESEM_L]);
+
+// Carves a signer, or an offline signer, out of the arena. Returns NULL if the arena is exhausted
+esem_signer_t* ESEM_Signer_New(esem_arena_t* arena);
+esem_offline_t* ESEM_Offline_New(esem_arena_t* arena);
+
+
+/**************** Key generation ****************/
+
+// Deterministic key generation from a 32-byte seed, on nthreads threads (at most ESEM_KEYGEN_MAX_THREADS are used)
+// Outputs: secret_key, public_key, the BPV_N-entry tables publicAll_* and secretAll_* and the level keys tempKey*
+ECCRYPTO_STATUS ESEM_KeyGen_Seeded(const unsigned char seed[32], unsigned char* secret_key, unsigned char* public_key, unsigned char* publicAll_1, unsigned char* publicAll_2, unsigned char* publicAll_3, unsigned char* secretAll_1, unsigned char* secretAll_2, unsigned char* secretAll_3, unsigned char* tempKey1, unsigned char* tempKey2, unsigned char* tempKey3, unsigned int nthreads);
+
+// Key generation from a fresh seed, stored in sk_aes, on ESEM_KEYGEN_THREADS threads
+ECCRYPTO_STATUS ESEM_KeyGen(unsigned char* sk_aes, unsigned char* secret_key, unsigned char* public_key, unsigned char* publicAll_1, unsigned char* publicAll_2, unsigned char* publicAll_3, unsigned char* secretAll_1, unsigned char* secretAll_2, unsigned char* secretAll_3, unsigned char* tempKey1, unsigned char* tempKey2, unsigned char* tempKey3);
+
+
+/**************** Signing ****************/
+
+// Signer setup: ESEMv1 (AES key schedules, secrets recomputed) or ESEMv2 (secrets looked up in the tables). Each
+// signature takes the next counter from the first one given, and a counter must never be used twice with the same keys:
+// ESEM_Signer_Done returns the first unused counter, to resume from
+void ESEM_Signer_Init(esem_signer_t* signer, const unsigned char sk_aes[32], const unsigned char secret_key[32], uint64_t counter);
+void ESEM_Signer_Init_v2(esem_signer_t* signer, const unsigned char secret_key[32], const unsigned char tempKey1[32], const unsigned char tempKey2[32], const unsigned char tempKey3[32], uint64_t counter);
+uint64_t ESEM_Signer_Done(esem_signer_t* signer);
+
+// Signature generation. Output: 48-byte signature x || s
+ECCRYPTO_STATUS ESEM_Signer_Sign(esem_signer_t* signer, unsigned char secret_key[32], unsigned char* message, unsigned char* signature);
+ECCRYPTO_STATUS ESEM_Signer_Sign_v2(esem_signer_t* signer, unsigned char secret_key[32], unsigned char* message, const unsigned char* secretAll_1, const unsigned char* secretAll_2, const unsigned char* secretAll_3, unsigned char* signature);
+
+// One-shot signatures, the signer state is kept on the stack. The caller keeps the counter, as above
+ECCRYPTO_STATUS ESEM_Sign(unsigned char sk_aes[32], unsigned char secret_key[32], unsigned char* message, uint64_t counter, unsigned char* signature);
+ECCRYPTO_STATUS ESEM_Sign_v2(unsigned char secret_key[32], unsigned char* message, const unsigned char* secretAll_1, const unsigned char* secretAll_2, const unsigned char* secretAll_3, unsigned char tempKey1[32], unsigned char tempKey2[32], unsigned char tempKey3[32], uint64_t counter, unsigned char* signature);
+
+// Offline/online ESEMv2 signing
+ECCRYPTO_STATUS ESEM_Offline_Init(esem_offline_t* offline, const unsigned char secret_key[32], const unsigned char* secretAll_1, const unsigned char* secretAll_2, const unsigned char* secretAll_3, const unsigned char tempKey1[32], const unsigned char tempKey2[32], const unsigned char tempKey3[32], uint64_t counter, int background);
+unsigned int ESEM_Offline_Fill(esem_offline_t* offline);
+ECCRYPTO_STATUS ESEM_Offline_Sign(esem_offline_t* offline, unsigned char* message, unsigned char* signature);
+uint64_t ESEM_Offline_Done(esem_offline_t* offline);
+
+// Signs n 32-byte messages, ESEM_SIGN_LANES at a time. Output: n 48-byte signatures
+ECCRYPTO_STATUS ESEM_Sign_batch(esem_offline_t* offline, const unsigned char* messages, unsigned int n, unsigned char* signatures);
+
+
+/**************** Server ****************/
+
+// Carves a server out of the arena and precomputes its tables from the public tables and the level keys
+esem_server_t* ESEM_Server_New(esem_arena_t* arena, const unsigned char* publicAll_1, const unsigned char* publicAll_2, const unsigned char* publicAll_3, const unsigned char tempKey1[32], const unsigned char tempKey2[32], const unsigned char tempKey3[32], esem_table_mode_t mode);
+
+// The 64-byte point answering the request (level, x)
+ECCRYPTO_STATUS ESEM_Server_Respond(const esem_server_t* server, unsigned int level, const unsigned char randValue[16], unsigned char lastPublic[64]);
+
+// The count points answering the requests level || x in entries, ESEM_BATCH_ENTRY_BYTES each as in a batch request
+ECCRYPTO_STATUS ESEM_Server_Respond_batch(const esem_server_t* server, const unsigned char* entries, unsigned int count, unsigned char* points);
+
+// Binds the server to endpoint before ESEM_Server_Pool runs, and stores the endpoint actually bound in bound, which may be NULL.
+// "tcp://127.0.0.1:*" binds to any free port
+ECCRYPTO_STATUS ESEM_Server_Bind(esem_server_t* server, const char* endpoint, char* bound, size_t bound_bytes);
+
+// Serves requests with nworkers threads on the endpoint given to ESEM_Server_Bind, ESEM_SERVER_ENDPOINT if it was not called.
+// Only returns if the sockets cannot be set up
+ECCRYPTO_STATUS ESEM_Server_Pool(esem_server_t* server, unsigned int nworkers);
+
+
+/**************** Verifier ****************/
+
+// Carves a verifier for batches of up to max_batch signatures out of the arena and connects it to the servers,
+// at ESEM_VERIFIER_ENDPOINTS or at the given endpoint of each level
+esem_verifier_t* ESEM_Verifier_New(esem_arena_t* arena, unsigned int max_batch);
+esem_verifier_t* ESEM_Verifier_New_Endpoints(esem_arena_t* arena, unsigned int max_batch, const char* const endpoints[ESEM_L]);
+void ESEM_Verifier_Done(esem_verifier_t* verifier);
+
+// Requests the points of count (level, x) pairs from a server in a single batch message, on a REQ socket
+ECCRYPTO_STATUS ESEM_Request_Batch(void* requester, const unsigned char* levels, const unsigned char* randValues, unsigned int count, unsigned char* points);
+
+// Signature verification. Returns ECCRYPTO_ERROR_SIGNATURE_VERIFICATION if the signature is invalid
+ECCRYPTO_STATUS ESEM_Verifier(esem_verifier_t* verifier, const unsigned char* signature, const unsigned char* message, const unsigned char public_key[64]);
+
+// Verifies count <= max_batch signatures together. valid[i] is set to 1 if signature i is valid and to 0 otherwise
+ECCRYPTO_STATUS ESEM_Verify_batch(esem_verifier_t* verifier, const unsigned char* signatures, const unsigned char* messages, const unsigned char* public_keys, unsigned int count, int* valid);
+
+
+/**************** Key store ****************/
+
+// Writes the keys to a new store file, readable by its owner only, that atomically replaces path. A signer store
+// (server NULL) holds the secrets if keys->secret_key is set, and the seed if it is set as well. A server store holds
+// the precomputed tables of server and no secrets: keys->secret_key must then be NULL
+ECCRYPTO_STATUS ESEM_Store_Write(const char* path, const esem_keys_t* keys, const esem_server_t* server);
+
+// Maps the store file at path read-only, to be shared by every process using it. Returns NULL if the file cannot
+// be mapped or was not written with this build's parameters
+esem_store_t* ESEM_Store_Open(esem_arena_t* arena, const char* path);
+void ESEM_Store_Close(esem_store_t* store);
+
+// ESEM_STORE_* flags of the store, and its keys, pointing into the mapping
+unsigned int ESEM_Store_Flags(const esem_store_t* store);
+void ESEM_Store_Keys(const esem_store_t* store, esem_keys_t* keys);
+
+// Carves a server out of the arena that uses the precomputed tables of the store in place. If the store has none,
+// they are precomputed in the arena as by ESEM_Server_New with the given mode
+esem_server_t* ESEM_Server_From_Store(esem_arena_t* arena, const esem_store_t* store, esem_table_mode_t mode);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif
@@ -121,6 +121,18 @@ ECCRYPTO_STATUS PublicKeyGeneration(const unsigned char* SecretKey, unsigned cha
 }
 
 
+ECCRYPTO_STATUS PublicKeyGeneration_batch(const unsigned char* SecretKey, unsigned char* PublicKey, unsigned int n)
+{ // Public key generation for n keys at once
+  // It produces the public keys PublicKey[i] = SecretKey[i]*G, where G is the generator, sharing the field inversions.
+  // Input:  n 32-byte SecretKeys, stored consecutively
+  // Output: n 64-byte PublicKeys, stored consecutively
+
+	ecc_mul_fixed_batch((digit_t*)SecretKey, n, (point_t*)PublicKey);  // Compute public keys
+
+	return ECCRYPTO_SUCCESS;
+}
+
+
 ECCRYPTO_STATUS KeyGeneration(unsigned char* SecretKey, unsigned char* PublicKey)
 { // Keypair generation for key exchange
   // It produces a private key SecretKey and computes the public key PublicKey = SecretKey*G, where G is the generator.
@@ -1,990 +1,506 @@
-/***********************************************************************************
-* FourQlib: a high-performance crypto library based on the elliptic curve FourQ
-*
-*    Copyright (c) Microsoft Corporation. All rights reserved.
-*
-* Abstract: testing code for cryptographic functions based on FourQ 
-************************************************************************************/   
-
-#include "../FourQ_api.h"
-#include "../FourQ_params.h"
- 
-#include "test_extras.h"
-#include <stdio.h>
-#include "aes.h"
-#include "aes256.h"
-#include "blake2.h"
-#include "zmq.h"
-#include <stdlib.h>
-
-#define HIGH_SPEED 1
-
-#define CMD_REQUEST_VERIFICATION         0x000010
-
-// Benchmark and test parameters 
-
-//For easy testing, no random keys are used in this implementation. secret_key, public_key should be generated new every time.
-
-#if defined(HIGH_SPEED) // This is ESEMv2
-    #define BENCH_LOOPS       100000      // Number of iterations per bench
-    #define BPV_V             40
-    #define ESEM_L            3
-    #define BPV_N             128
-#else 
-    #define BENCH_LOOPS       100000
-    #define BPV_V             18
-    #define ESEM_L            3
-    #define BPV_N             1024
-#endif
- 
-void menu(){
-    printf("NOTE: Currently, our implementation only has the communication between the verifier and the server \n");
-    printf("NOTE: Therefore, Key Generation, Signer and Verifier should be run on same terminal. \n");        
-    // printf("NOTE: Before running the server, key generation should be run once. \n");        
-    printf("Select one of the following: \n");
-    printf("(1) Key Generation\n");
-    printf("(2) Signer\n");
-    printf("(3) Server\n");
-    printf("(4) Verifier\n");
-    printf("(5) Exit\n\n\n");
-
-}
-
-/**
- * Prints the given byte array in hexadecimal format.
- *
- * @param data The byte array to print.
- * @param length The length of the byte array.
- */
-void print_hex(const unsigned char *data, size_t length)
-{
-    for (size_t i = 0; i < length; i++)
-    {
-        printf("%02X", data[i]); // Prints each byte in hex format
-    }
-    printf("\n");
-}
-
-// Helper function to generate public key from secret key
-ECCRYPTO_STATUS generateKeys(aes256_context_t *ctx, unsigned char *prf_out2, unsigned char *publicTemp, uint64_t iteration, unsigned char *publicAll, unsigned char *secretAll, double *total_time)
-{
-    aes256_blk_t prf_out;
-    clock_t start, end;
-
-    uint8_t counter[16] = {0};
-    counter[15] = (uint8_t)(iteration + 1);
-
-    // Encrypt counter using provided AES context
-    start = clock();
-    aes256_encrypt_ecb(ctx, &prf_out);
-    end = clock();
-
-    // Measure encryption time
-    double cpu_time_used = ((double)(end - start)) / CLOCKS_PER_SEC;
-    *total_time += cpu_time_used; // Accumulate the time for each iteration
-
-    // Print encryption time
-    //printf("Encryption time for iteration %llu: %f seconds\n", iteration + 1, cpu_time_used);
-
-    // Copy encrypted counter to buffer
-    memcpy(prf_out2, prf_out.raw, 32);
-    modulo_order((digit_t *)prf_out2, (digit_t *)prf_out2);
-
-    // Generate public key
-    start = clock();
-    ECCRYPTO_STATUS status = PublicKeyGeneration(prf_out2, publicTemp);
-    if (status != ECCRYPTO_SUCCESS)
-    {
-        return status;
-    }
-    end = clock();
-
-    // Measure public key gen time
-    cpu_time_used = ((double)(end - start)) / CLOCKS_PER_SEC;
-    //printf("Public key generation time for iteration %llu: %f seconds\n", iteration + 1, cpu_time_used);
-
-    // Copy keys to output buffers
-    memcpy(publicAll + iteration * 64, publicTemp, 64);
-    memcpy(secretAll + iteration * 32, prf_out2, 32);
-
-    return ECCRYPTO_SUCCESS;
-}
-
-/**
- * Generates public and secret keys for the ESEM (Efficient Secure Enrollment Mechanism) protocol.
- *
- * This function performs the following steps:
- * 1. Generates AES-256 encryption keys using a counter-based approach.
- * 2. Generates a public/secret key pair using the ECCRYPTO library.
- * 3. Generates multiple public and secret key pairs using the generated AES-256 keys and stores them in the provided buffers.
- * 4. Calculates the average encryption time for the key generation process.
- *
- * @param sk_aes The buffer to store the AES-256 secret key.
- * @param secret_key The buffer to store the generated secret key.
- * @param public_key The buffer to store the generated public key.
- * @param publicAll_1 The buffer to store the first set of generated public keys.
- * @param publicAll_2 The buffer to store the second set of generated public keys.
- * @param publicAll_3 The buffer to store the third set of generated public keys.
- * @param secretAll_1 The buffer to store the first set of generated secret keys.
- * @param secretAll_2 The buffer to store the second set of generated secret keys.
- * @param secretAll_3 The buffer to store the third set of generated secret keys.
- * @param tempKey1 The buffer to store the first temporary AES-256 key.
- * @param tempKey2 The buffer to store the second temporary AES-256 key.
- * @param tempKey3 The buffer to store the third temporary AES-256 key.
- * @return ECCRYPTO_STATUS The status of the key generation process.
- */
-ECCRYPTO_STATUS ESEM_KeyGen(unsigned char *sk_aes, unsigned char *secret_key, unsigned char *public_key, unsigned char *publicAll_1, unsigned char *publicAll_2, unsigned char *publicAll_3, unsigned char *secretAll_1, unsigned char *secretAll_2, unsigned char *secretAll_3, unsigned char *tempKey1, unsigned char *tempKey2, unsigned char *tempKey3)
-{
-    ECCRYPTO_STATUS Status = ECCRYPTO_SUCCESS;
-    clock_t start, end;
-
-    unsigned char publicTemp[64];
-    aes256_key_t aes_key;
-
-    // Initialize AES context with generated key 
-    aes256_context_t ctx;
-
-    // Generate 3 distinct AES keys using counters 
-    // These will be used to generate multiple key pairs
-    aes256_blk_t ctr1, ctr2, ctr3;
-
-    // Measure time to encrypt counters
-    start = clock();
-    end = clock();
-    double cpu_time_used = ((double)(end - start)) / CLOCKS_PER_SEC;
-    printf("Encryption time for counters: %f seconds\n", cpu_time_used);
-
-    memcpy(tempKey1, ctr1.raw, 32);
-    memcpy(tempKey2, ctr2.raw, 32);
-    memcpy(tempKey3, ctr3.raw, 32);
-
-    aes256_done(&ctx);
-
-    // Generate initial public/private key pair
-    start = clock();
-    if (Status != ECCRYPTO_SUCCESS)
-    {
-        return Status;
-    }
-    end = clock();
-    cpu_time_used = ((double)(end - start)) / CLOCKS_PER_SEC;
-    printf("Key pair generation time: %f seconds\n", cpu_time_used);
-    printf("Initial secret_key: ");
-    print_hex(secret_key, 32);
-    printf("Initial public_key: ");  
-    print_hex(public_key, 64);
-
-    // Initialize AES contexts with generated keys
-    aes256_context_t ctx1, ctx2, ctx3;
-    aes256_init(&ctx1, (aes256_key_t *)tempKey1);
-    aes256_init(&ctx2, (aes256_key_t *)tempKey2);
-    aes256_init(&ctx3, (aes256_key_t *)tempKey3);
-
-    unsigned char prf_out2[32];
-    double total_time_ctx1 = 0.0, total_time_ctx2 = 0.0, total_time_ctx3 = 0.0;
-
-    // Generate multiple key pairs using each context
-    for (uint64_t i = 0; i < BPV_N; i++)
-    {
-        // Generate initial AES-256 key
-        if (!RAND_bytes(sk_aes, 32)) {
-            return ECCRYPTO_ERROR;
-        }
-
-        // Initialize AES context 
-        aes256_init(&ctx, &aes_key);
-
-        // Encrypt counter
-        aes256_encrypt_ecb(&ctx, &ctr1);
-
-        // Derive secret key
-        memcpy(secret_key, ctr1.raw, 32);
-
-        // Generate public key 
-        Status = PublicKeyGeneration(secret_key, public_key);
-
-        // Call helper function for each iteration and each context
-        Status = generateKeys(&ctx1, prf_out2, publicTemp, i, publicAll_1, secretAll_1, &total_time_ctx1);
-        if (Status != ECCRYPTO_SUCCESS)
-        {
-            return Status;
-        }
-    }
-    printf("secret_key after first round of AES encryption: ");
-    print_hex(secret_key, sizeof(secret_key));
-    printf("public_key after first round of AES encryption: ");  
-    print_hex(public_key, sizeof(public_key));
-
-    for (uint64_t i = 0; i < BPV_N; i++)
-    {
-        // Generate AES key
-        if (!RAND_bytes(sk_aes, 32)) {
-            return ECCRYPTO_ERROR;
-        }  
-
-        // Initialize AES context 
-        aes256_init(&ctx, &aes_key);
-
-        // Encrypt counter
-        aes256_encrypt_ecb(&ctx, &ctr2);
-
-        // Derive secret key
-        memcpy(secret_key, ctr2.raw, 32);  
-
-        // Generate public key 
-        Status = PublicKeyGeneration(secret_key, public_key);
-
-        // Call helper function for each iteration and each context
-        Status = generateKeys(&ctx2, prf_out2, publicTemp, i, publicAll_2, secretAll_2, &total_time_ctx2);
-        if (Status != ECCRYPTO_SUCCESS)
-        {
-            return Status;
-        }
-    }
-    printf("secret_key after second round of AES-256 encryption: ");
-    print_hex(secret_key, sizeof(secret_key));
-    printf("public_key after second round of AES-256 encryption: ");  
-    print_hex(public_key, sizeof(public_key));
-
-    for (uint64_t i = 0; i < BPV_N; i++)
-    {
-        // Generate AES key
-        if (!RAND_bytes(sk_aes, 32)) {
-            return ECCRYPTO_ERROR;
-        }  
-
-        // Initialize AES context 
-        aes256_init(&ctx, &aes_key);
-
-        // Encrypt counter
-        aes256_encrypt_ecb(&ctx, &ctr3);
-
-        // Derive secret key
-        memcpy(secret_key, ctr3.raw, 32);
-
-        // Generate public key 
-        Status = PublicKeyGeneration(secret_key, public_key);
-
-        // Call helper function for each iteration and each context
-        Status = generateKeys(&ctx3, prf_out2, publicTemp, i, publicAll_3, secretAll_3, &total_time_ctx3);
-        if (Status != ECCRYPTO_SUCCESS)
-        {
-            return Status;
-        }
-    }
-
-    aes256_done(&ctx1);
-    aes256_done(&ctx2);
-    aes256_done(&ctx3);
-
-    // Calculate average time over all iterations
-    double average_time_ctx1 = total_time_ctx1 / BPV_N;
-    double average_time_ctx2 = total_time_ctx2 / BPV_N;
-    double average_time_ctx3 = total_time_ctx3 / BPV_N;
-
-    // Calculate average time over all contexts
-    double total_average_time = average_time_ctx1 + average_time_ctx2 + average_time_ctx3;
-    total_average_time /= 3;
-
-    printf("Final secret_key: ");
-    print_hex(secret_key, 32);
-    printf("Final public_key: ");  
-    print_hex(public_key, 64);
-
-    printf("Average encryption time for ctx1: %f seconds\n", average_time_ctx1);
-    printf("Average encryption time for ctx2: %f seconds\n", average_time_ctx2);
-    printf("Average encryption time for ctx3: %f seconds\n", average_time_ctx3);
-    printf("Total average encryption time: %f seconds\n", total_average_time);
-    printf("sk-aes: ");
-    print_hex(sk_aes, 32);
-
-    return ECCRYPTO_SUCCESS;
-}
-
-ECCRYPTO_STATUS ESEM_Sign(unsigned char sk_aes[32], unsigned char secret_key[32], unsigned char *message, unsigned char *signature){
-
-    // ECCRYPTO_STATUS Status = ECCRYPTO_SUCCESS;
-
-    block* prf_out;
-    unsigned char *prf_out2;
-    prf_out = malloc(16*2);
-    prf_out2 = malloc(16*2);
-    uint64_t i, index, index2;
-
-    unsigned char randValue[16] = {0}; //This is x in the scheme
-    unsigned char counter[8] = {0};
-    unsigned char hashOutput[36] = {0};
-
-    unsigned char secretTemp[32];
-    unsigned char secretTemp2[32];
-    unsigned char lastSecret[32];
-    digit_t* r = (digit_t*)(lastSecret);
-    digit_t* S = (digit_t*)(signature+16);  
-    digit_t* Secret = (digit_t*)(secretTemp2);  
-
-    unsigned char tempKey1[32];
-    unsigned char tempKey2[32];
-    unsigned char tempKey3[32];
-
-    blake2b(randValue, counter, secret_key, 16,8,32);
-    // print_hex(randValue, 16);
-
-    memcpy(signature, randValue,  16);
-
-    block key;
-    key = toBlock((uint8_t*)sk_aes);
-    setKey(key);
-
-    index = 1;
-    ecbEncCounterMode(index,2,prf_out);
-    memmove(tempKey1,prf_out,32);
-
-    key = toBlock((uint8_t*)tempKey1);
-    setKey(key);
-
-    blake2b(hashOutput, randValue, tempKey1, 36, 16, 32);
-
-    index2 = hashOutput[0] + ((hashOutput[1]/64) * 256);
-
-    ecbEncCounterMode(index2,2,prf_out);
-    memmove(secretTemp,prf_out,32);
-
-    modulo_order((digit_t*)secretTemp, (digit_t*)secretTemp);
-
-    index2 = hashOutput[2] + ((hashOutput[3]/64) * 256);
-
-    ecbEncCounterMode(index2,2,prf_out);
-    memmove(secretTemp2,prf_out,32);
-
-    modulo_order((digit_t*)secretTemp2, (digit_t*)secretTemp2);
-    add_mod_order((digit_t*)secretTemp, (digit_t*)secretTemp2, r);
-
-    for (i = 2; i < BPV_V; ++i) { 
-        index2 = hashOutput[2*i] + ((hashOutput[2*i+1]/64) * 256);
-      
-        ecbEncCounterMode(index2,2,prf_out);
-        memmove(secretTemp,prf_out,32);
-
-        modulo_order((digit_t*)secretTemp, (digit_t*)secretTemp);
-        add_mod_order((digit_t*)secretTemp, r, r); // Add the r_i's and compute the final r
-    }
-
-    key = toBlock((uint8_t*)sk_aes);
-    setKey(key);
-
-    index = 2;
-    ecbEncCounterMode(index,2,prf_out);
-    memmove(tempKey2,prf_out,32);
-
-    key = toBlock((uint8_t*)tempKey2);
-    setKey(key);
-
-    blake2b(hashOutput, randValue, tempKey2, 36, 16, 32);
-
-    for (i = 0; i < BPV_V; ++i) { 
-        index2 = hashOutput[2*i] + ((hashOutput[2*i+1]/64) * 256);
-      
-        ecbEncCounterMode(index2,2,prf_out);
-        memmove(secretTemp,prf_out,32);
-
-        modulo_order((digit_t*)secretTemp, (digit_t*)secretTemp);
-        add_mod_order((digit_t*)secretTemp, r, r); // Add the r_i's and compute the final r
-    }
-
-
-    key = toBlock((uint8_t*)sk_aes);
-    setKey(key);
-
-    index = 3;
-    ecbEncCounterMode(index,2,prf_out);
-    memmove(tempKey3,prf_out,32);
-
-    key = toBlock((uint8_t*)tempKey3);
-    setKey(key);
-
-    blake2b(hashOutput, randValue, tempKey3, 36, 16, 32);
-
-    for (i = 0; i < BPV_V; ++i) { 
-        index2 = hashOutput[2*i] + ((hashOutput[2*i+1]/64) * 256);
-      
-        ecbEncCounterMode(index2,2,prf_out);
-        memmove(secretTemp,prf_out,32);
-
-        modulo_order((digit_t*)secretTemp, (digit_t*)secretTemp);
-        add_mod_order((digit_t*)secretTemp, r, r); // Add the r_i's and compute the final r -- Last r is calculated here (if l = 3)
-    }
-
-    unsigned char hashedMsg[32] = {0}; 
-    blake2b(hashedMsg, message, randValue, 32, 32, 16);
-
-    modulo_order((digit_t*)hashedMsg, (digit_t*)hashedMsg);
-
-    to_Montgomery((digit_t*)hashedMsg, S);
-    to_Montgomery((digit_t*)secret_key, Secret);
-    Montgomery_multiply_mod_order(S, Secret, S);
-    from_Montgomery(S, S);
-    subtract_mod_order(r, S, S);
-
-
-
-    free(prf_out);
-    free(prf_out2); 
-
-    return ECCRYPTO_SUCCESS;
-
-}
-
-ECCRYPTO_STATUS ESEM_Sign_v2(unsigned char secret_key[32], unsigned char *message, unsigned char *secretAll_1, unsigned char *secretAll_2, unsigned char *secretAll_3, unsigned char tempKey1[32], unsigned char tempKey2[32], unsigned char tempKey3[32], unsigned char *signature){
-
-    uint64_t i;
-
-    unsigned char randValue[16] = {0}; //This is x in the scheme
-    unsigned char counter[8] = {0};
-    unsigned char hashOutput[40] = {0};
-
-    unsigned char secretTemp[32];
-    unsigned char secretTemp2[32];
-    unsigned char lastSecret[32];
-    digit_t* r = (digit_t*)(lastSecret);
-    digit_t* S = (digit_t*)(signature+16);  
-    digit_t* Secret = (digit_t*)(secretTemp2);  
-
-
-    blake2b(randValue, counter, secret_key, 16,8,32);
-
-    memcpy(signature, randValue,  16);
-
-    blake2b(hashOutput, randValue, tempKey1, 40, 16, 32);
-
-    hashOutput[0] = hashOutput[0]/2;
-    memmove(secretTemp, secretAll_1 + hashOutput[0]*32, 32);
-    // modulo_order((digit_t*)secretTemp, (digit_t*)secretTemp);
-
-    hashOutput[1] = hashOutput[1]/2;
-    memmove(secretTemp2, secretAll_1 + hashOutput[1]*32, 32);
-    // modulo_order((digit_t*)secretTemp2, (digit_t*)secretTemp2);
-    add_mod_order((digit_t*)secretTemp, (digit_t*)secretTemp2, r);
-
-    for (i = 2; i < BPV_V; ++i) { 
-        hashOutput[i] = hashOutput[i]/2;
-        memmove(secretTemp,secretAll_1 + hashOutput[i]*32, 32);
-
-        // modulo_order((digit_t*)secretTemp, (digit_t*)secretTemp);
-        add_mod_order((digit_t*)secretTemp, r, r); // Add the r_i's and compute the final r
-    }
-
-
-    blake2b(hashOutput, randValue, tempKey2, 40, 16, 32);
-
-    for (i = 0; i < BPV_V; ++i) { 
-        hashOutput[i] = hashOutput[i]/2;
-        memmove(secretTemp,secretAll_2 + hashOutput[i]*32, 32);
-
-        // modulo_order((digit_t*)secretTemp, (digit_t*)secretTemp);
-        add_mod_order((digit_t*)secretTemp, r, r); // Add the r_i's and compute the final r
-    }
-
-
-    blake2b(hashOutput, randValue, tempKey3, 40, 16, 32);
-    
-    for (i = 0; i < BPV_V; ++i) { 
-        hashOutput[i] = hashOutput[i]/2;
-        memmove(secretTemp,secretAll_3 + hashOutput[i]*32, 32);
-
-        // modulo_order((digit_t*)secretTemp, (digit_t*)secretTemp);
-        add_mod_order((digit_t*)secretTemp, r, r); // Add the r_i's and compute the final r
-    }
-
-
-    unsigned char hashedMsg[32] = {0}; 
-    blake2b(hashedMsg, message, randValue, 32, 32, 16);
-
-    modulo_order((digit_t*)hashedMsg, (digit_t*)hashedMsg);
-
-    to_Montgomery((digit_t*)hashedMsg, S);
-    to_Montgomery((digit_t*)secret_key, Secret);
-    Montgomery_multiply_mod_order(S, Secret, S);
-    from_Montgomery(S, S);
-    subtract_mod_order(r, S, S);
-
-
-
-    return ECCRYPTO_SUCCESS;
-
-}
-
-
-ECCRYPTO_STATUS ESEM_Server(unsigned char *publicAll_1, unsigned char *publicAll_2, unsigned char *publicAll_3, unsigned char tempKey1[32], unsigned char tempKey2[32], unsigned char tempKey3[32]){
-
-    ECCRYPTO_STATUS Status = ECCRYPTO_SUCCESS;
-
-    unsigned char randValue[16];
-    unsigned char hashOutput[36] = {0};
-    uint64_t i, index2;
-    unsigned char lastPublic1[64];
-    unsigned char lastPublic2[64];
-    unsigned char lastPublic3[64];
-    unsigned char publicTemp[64];   
-    point_extproj_t TempExtproj1, TempExtproj2, TempExtproj3;
-    point_extproj_precomp_t TempExtprojPre1, TempExtprojPre2, TempExtprojPre3;
-    point_extproj_t RVerify1, RVerify2, RVerify3;
-
-    void *context = zmq_ctx_new ();
-    void *responder = zmq_socket (context, ZMQ_REP);
-    int rc = zmq_bind (responder, "tcp://*:5555");
-
-    zmq_recv (responder, randValue, 16, 0);
-    print_hex(randValue, 16);
-
-
-    blake2b(hashOutput, randValue, tempKey1, 36, 16, 32);
-
-    index2 = hashOutput[0] + ((hashOutput[1]/64) * 256);
-    
-    memmove(publicTemp,publicAll_1 +64*index2, 64);
-    point_setup((point_affine*)publicTemp, RVerify1);
-
-    index2 = hashOutput[2] + ((hashOutput[3]/64) * 256);
-
-    memmove(publicTemp,publicAll_1 +64*index2, 64);
-    point_setup((point_affine*)publicTemp, TempExtproj1);
-
-    R1_to_R2(TempExtproj1, TempExtprojPre1);
-    eccadd(TempExtprojPre1, RVerify1);
-
-
-    for (i = 2; i < BPV_V; ++i) { // Same as above happens in the loop
-        index2 = hashOutput[2*i] + ((hashOutput[2*i+1]/64) * 256);
-
-        memmove(publicTemp,publicAll_1 +64*index2,64);
-        point_setup((point_affine*)publicTemp, TempExtproj1);
-
-        R1_to_R2(TempExtproj1, TempExtprojPre1);
-        eccadd(TempExtprojPre1, RVerify1);   // Add the R[i]'s and compute the final R
-    }
-
-    eccnorm(RVerify1, (point_affine*)lastPublic1);
-
-    zmq_send(responder, lastPublic1, 64, 0);
-
-    zmq_recv (responder, randValue, 16, 0);
-    print_hex(randValue, 16);
-
-
-
-    blake2b(hashOutput, randValue, tempKey2, 36, 16, 32);
-
-    index2 = hashOutput[0] + ((hashOutput[1]/64) * 256);
-    
-    memmove(publicTemp,publicAll_2 +64*index2, 64);
-    point_setup((point_affine*)publicTemp, RVerify2);
-
-    index2 = hashOutput[2] + ((hashOutput[3]/64) * 256);
-
-    memmove(publicTemp,publicAll_2 +64*index2, 64);
-    point_setup((point_affine*)publicTemp, TempExtproj2);
-
-    R1_to_R2(TempExtproj2, TempExtprojPre2);
-    eccadd(TempExtprojPre2, RVerify2);
-
-
-    for (i = 2; i < BPV_V; ++i) { // Same as above happens in the loop
-        index2 = hashOutput[2*i] + ((hashOutput[2*i+1]/64) * 256);
-
-        memmove(publicTemp,publicAll_2 +64*index2,64);
-        point_setup((point_affine*)publicTemp, TempExtproj2);
-
-        R1_to_R2(TempExtproj2, TempExtprojPre2);
-        eccadd(TempExtprojPre2,RVerify2);   // Add the R[i]'s and compute the final R
-    }
-
-    eccnorm(RVerify2, (point_affine*)lastPublic2);
-
-    zmq_send(responder, lastPublic2, 64, 0);
-
-    zmq_recv (responder, randValue, 16, 0);
-    print_hex(randValue, 16);
-
-
-    blake2b(hashOutput, randValue, tempKey3, 36, 16, 32);
-
-    index2 = hashOutput[0] + ((hashOutput[1]/64) * 256);
-    
-    memmove(publicTemp,publicAll_3 +64*index2, 64);
-    point_setup((point_affine*)publicTemp, RVerify3);
-
-    index2 = hashOutput[2] + ((hashOutput[3]/64) * 256);
-
-    memmove(publicTemp,publicAll_3 +64*index2, 64);
-    point_setup((point_affine*)publicTemp, TempExtproj3);
-
-    R1_to_R2(TempExtproj3, TempExtprojPre3);
-    eccadd(TempExtprojPre3, RVerify3);
-
-
-    for (i = 2; i < BPV_V; ++i) { // Same as above happens in the loop
-        index2 = hashOutput[2*i] + ((hashOutput[2*i+1]/64) * 256);
-
-        memmove(publicTemp,publicAll_3 +64*index2,64);
-        point_setup((point_affine*)publicTemp, TempExtproj3);
-
-        R1_to_R2(TempExtproj3, TempExtprojPre3);
-        eccadd(TempExtprojPre3,RVerify3);   // Add the R[i]'s and compute the final R
-    }
-
-    eccnorm(RVerify3, (point_affine*)lastPublic3);
-
-    zmq_send(responder, lastPublic3, 64, 0);
-
-
-    return Status;
-
-}
-
-
-ECCRYPTO_STATUS ESEM_Server_v2(unsigned char *publicAll_1, unsigned char *publicAll_2, unsigned char *publicAll_3, unsigned char tempKey1[32], unsigned char tempKey2[32], unsigned char tempKey3[32]){
-
-    ECCRYPTO_STATUS Status = ECCRYPTO_SUCCESS;
-
-    unsigned char randValue[16];
-    unsigned char hashOutput[40] = {0};
-    uint64_t i, index2;
-    unsigned char lastPublic1[64];
-    unsigned char lastPublic2[64];
-    unsigned char lastPublic3[64];
-    unsigned char publicTemp[64];   
-    point_extproj_t TempExtproj1, TempExtproj2, TempExtproj3;
-    point_extproj_precomp_t TempExtprojPre1, TempExtprojPre2, TempExtprojPre3;
-    point_extproj_t RVerify1, RVerify2, RVerify3;
-
-    void *context = zmq_ctx_new ();
-    void *responder = zmq_socket (context, ZMQ_REP);
-    int rc = zmq_bind (responder, "tcp://*:5555");
-
-    zmq_recv (responder, randValue, 16, 0);
-    print_hex(randValue, 16);
-
-
-    blake2b(hashOutput, randValue, tempKey1, 40, 16, 32);
-
-    index2 = hashOutput[0]/2;
-    
-    memmove(publicTemp,publicAll_1 +64*index2, 64);
-    point_setup((point_affine*)publicTemp, RVerify1);
-
-    index2 = hashOutput[1]/2;
-
-    memmove(publicTemp,publicAll_1 +64*index2, 64);
-    point_setup((point_affine*)publicTemp, TempExtproj1);
-
-    R1_to_R2(TempExtproj1, TempExtprojPre1);
-    eccadd(TempExtprojPre1, RVerify1);
-
-
-    for (i = 2; i < BPV_V; ++i) { // Same as above happens in the loop
-        index2 = hashOutput[i]/2;
-
-        memmove(publicTemp,publicAll_1 +64*index2,64);
-        point_setup((point_affine*)publicTemp, TempExtproj1);
-
-        R1_to_R2(TempExtproj1, TempExtprojPre1);
-        eccadd(TempExtprojPre1, RVerify1);   // Add the R[i]'s and compute the final R
-    }
-
-    eccnorm(RVerify1, (point_affine*)lastPublic1);
-
-    zmq_send(responder, lastPublic1, 64, 0);
-
-    zmq_recv (responder, randValue, 16, 0);
-    print_hex(randValue, 16);
-
-
-
-    blake2b(hashOutput, randValue, tempKey2, 40, 16, 32);
-
-    index2 = hashOutput[0]/2;
-    
-    memmove(publicTemp,publicAll_2 +64*index2, 64);
-    point_setup((point_affine*)publicTemp, RVerify2);
-
-    index2 = hashOutput[1]/2;
-
-    memmove(publicTemp,publicAll_2 +64*index2, 64);
-    point_setup((point_affine*)publicTemp, TempExtproj2);
-
-    R1_to_R2(TempExtproj2, TempExtprojPre2);
-    eccadd(TempExtprojPre2, RVerify2);
-
-
-    for (i = 2; i < BPV_V; ++i) { // Same as above happens in the loop
-        index2 = hashOutput[i]/2;
-
-        memmove(publicTemp,publicAll_2 +64*index2,64);
-        point_setup((point_affine*)publicTemp, TempExtproj2);
-
-        R1_to_R2(TempExtproj2, TempExtprojPre2);
-        eccadd(TempExtprojPre2,RVerify2);   // Add the R[i]'s and compute the final R
-    }
-
-    eccnorm(RVerify2, (point_affine*)lastPublic2);
-
-    zmq_send(responder, lastPublic2, 64, 0);
-
-    zmq_recv (responder, randValue, 16, 0);
-    print_hex(randValue, 16);
-
-
-    blake2b(hashOutput, randValue, tempKey3, 40, 16, 32);
-
-    index2 = hashOutput[0]/2;
-    
-    memmove(publicTemp,publicAll_3 +64*index2, 64);
-    point_setup((point_affine*)publicTemp, RVerify3);
-
-    index2 = hashOutput[1]/2;
-
-    memmove(publicTemp,publicAll_3 +64*index2, 64);
-    point_setup((point_affine*)publicTemp, TempExtproj3);
-
-    R1_to_R2(TempExtproj3, TempExtprojPre3);
-    eccadd(TempExtprojPre3, RVerify3);
-
-
-    for (i = 2; i < BPV_V; ++i) { // Same as above happens in the loop
-        index2 = hashOutput[i]/2;
-
-        memmove(publicTemp,publicAll_3 +64*index2,64);
-        point_setup((point_affine*)publicTemp, TempExtproj3);
-
-        R1_to_R2(TempExtproj3, TempExtprojPre3);
-        eccadd(TempExtprojPre3,RVerify3);   // Add the R[i]'s and compute the final R
-    }
-
-    eccnorm(RVerify3, (point_affine*)lastPublic3);
-
-    zmq_send(responder, lastPublic3, 64, 0);
-
-    zmq_close (responder);
-    zmq_ctx_destroy (context);
-
-    return Status;
-
-}
-
-
-ECCRYPTO_STATUS ESEM_Verifier(unsigned char *signature,  unsigned char *message, unsigned char public_key[64]){
-
-    ECCRYPTO_STATUS Status = ECCRYPTO_SUCCESS;
-
-    unsigned char public_value1[64];
-    unsigned char public_value2[64];
-    unsigned char public_value3[64];
-    unsigned char lastPublic[64];
-    unsigned char lastPublic_Verify[64];
-
-
-    point_extproj_t TempExtproj;
-    point_extproj_precomp_t TempExtprojPre;
-    point_extproj_t RVerify;
-
-
-    void *context = zmq_ctx_new ();
-    void *requester = zmq_socket (context, ZMQ_REQ);
-    zmq_connect (requester, "tcp://localhost:5555");
-
-    zmq_send (requester, signature, 16, 0);
-    zmq_recv (requester, public_value1, 64, 0);
-
-    zmq_send (requester, signature, 16, 0);
-    zmq_recv (requester, public_value2, 64, 0);
-
-    zmq_send (requester, signature, 16, 0);
-    zmq_recv (requester, public_value3, 64, 0);
-
-
-    point_setup((point_affine*)public_value1, RVerify);
-    point_setup((point_affine*)public_value2, TempExtproj);
-
-    R1_to_R2(TempExtproj, TempExtprojPre);
-    eccadd(TempExtprojPre, RVerify);
-
-    point_setup((point_affine*)public_value3, TempExtproj);
-
-    R1_to_R2(TempExtproj, TempExtprojPre);
-    eccadd(TempExtprojPre, RVerify);   // Add the R[i]'s and compute the final R
-
-    eccnorm(RVerify, (point_affine*)lastPublic);
-
-    unsigned char hashedMsg[32] = {0}; 
-    blake2b(hashedMsg, message, signature, 32, 32, 16);
-
-    modulo_order((digit_t*)hashedMsg, (digit_t*)hashedMsg);
-
-
-    ecc_mul_double((digit_t*)(signature+16), (point_affine*)public_key, (digit_t*)hashedMsg, (point_affine*)lastPublic_Verify);
-
-    if(memcmp(lastPublic, lastPublic_Verify, 64) == 0)
-        printf("Verified");
-    else
-        printf("Not Verified");
-
-    zmq_close (requester);
-    zmq_ctx_destroy (context);
-
-    return Status;
-
-}
-
-
-
-
-
-int main()
-{
-    //AES Key
-    unsigned char sk_aes[32] = {0x54, 0xa2, 0xf8, 0x03, 0x1d, 0x18, 0xac, 0x77, 0xd2, 0x53, 0x92, 0xf2, 0x80, 0xb4, 0xb1, 0x2f, 0xac, 0xf1, 0x29, 0x3f, 0x3a, 0xe6, 0x77, 0x7d, 0x74, 0x15, 0x67, 0x91, 0x99, 0x53, 0x69, 0xc5}; 
-
-    //Schnorr Key
-    unsigned char secret_key[32] =  {0x54, 0xa2, 0xf8, 0x03, 0x1d, 0x18, 0xac, 0x77, 0xd2, 0x53, 0x92, 0xf2, 0x80, 0xb4, 0xb1, 0x2f, 0xac, 0xf1, 0x29, 0x3f, 0x3a, 0xe6, 0x77, 0x7d, 0x74, 0x15, 0x67, 0x91, 0x99, 0x53, 0x69, 0xc5}; 
-    unsigned char *publicAll_1, *publicAll_2, *publicAll_3, *secretAll_1, *secretAll_2, *secretAll_3, *message, *signature;
-    unsigned char tempKey1[32], tempKey2[32], tempKey3[32], public_key[64]; //These are the keys to be shared with Parties.
-    publicAll_1 = malloc(BPV_N*64);
-    publicAll_2 = malloc(BPV_N*64);
-    publicAll_3 = malloc(BPV_N*64);
-    secretAll_1 = malloc(BPV_N*32);
-    secretAll_2 = malloc(BPV_N*32);
-    secretAll_3 = malloc(BPV_N*32);
-    message = malloc(32);
-    signature = malloc(48);
-    memset(message, 0, 32);
-    uint64_t benchLoop;
-    benchLoop = 0;
-
-    //  Benchmarking variables 
-    double SignTime, VerifyTime;
-    SignTime = 0.0;
-    VerifyTime = 0.0;
-    clock_t start, start2;
-    clock_t end, end2; 
-    // unsigned long long cycles, cycles1, cycles2;     
-    // unsigned long long vcycles, vcycles1, vcycles2;
-
-    ECCRYPTO_STATUS Status = ECCRYPTO_SUCCESS;
-    int userType;
-
-    modulo_order((digit_t*)secret_key, (digit_t*)secret_key);
-
-    Status = ESEM_KeyGen(sk_aes, secret_key, public_key, publicAll_1, publicAll_2, publicAll_3, secretAll_1, secretAll_2, secretAll_3, tempKey1, tempKey2, tempKey3);
-    if (Status != ECCRYPTO_SUCCESS) {
-        printf("Problem Occurred in KeyGen");
-    }
-
-#if defined(HIGH_SPEED)
-    printf("High Speed\n");
-    for(benchLoop = 0; benchLoop <BENCH_LOOPS; benchLoop++){
-        start = clock();
-        Status = ESEM_Sign_v2(secret_key, message, secretAll_1, secretAll_2, secretAll_3, tempKey1, tempKey2, tempKey3, signature);
-        end = clock();
-        SignTime = SignTime +(double)(end-start);
-    }
-#else 
-    for(benchLoop = 0; benchLoop <BENCH_LOOPS; benchLoop++){
-        start = clock();
-        Status = ESEM_Sign(sk_aes, secret_key, message, signature);
-        end = clock();
-        SignTime = SignTime +(double)(end-start);
-    }
-#endif
-    if (Status != ECCRYPTO_SUCCESS) {
-        printf("Problem Occurred in Sign");
-    }
-
-    printf("%fus per sign\n", ((double) (SignTime * 1000)) / CLOCKS_PER_SEC / BENCH_LOOPS * 1000);
-    print_hex(signature, 48);
-
-
-    printf("This is a proof-of-concept implementation!!! \n");
-
-
-    while(1){
-        menu();
-
-        scanf ("%d",&userType);
-        if(userType==1){
-            printf("Key Generation\n");
-            Status = ESEM_KeyGen(sk_aes, secret_key, public_key, publicAll_1, publicAll_2, publicAll_3, secretAll_1, secretAll_2, secretAll_3, tempKey1, tempKey2, tempKey3);
-            if (Status != ECCRYPTO_SUCCESS) {
-                printf("Problem Occurred in KeyGen");
-            }
-        }
-        else if(userType==2){
-            printf("Signer\n");
-#if defined(HIGH_SPEED)
-            printf("High Speed\n");
-            // for(benchLoop = 0; benchLoop <BENCH_LOOPS; benchLoop++){
-                // start = clock();
-            Status = ESEM_Sign_v2(secret_key, message, secretAll_1, secretAll_2, secretAll_3, tempKey1, tempKey2, tempKey3, signature);
-                // end = clock();
-                // SignTime = SignTime +(double)(end-start);
-            // }
-#else 
-            // for(benchLoop = 0; benchLoop <BENCH_LOOPS; benchLoop++){
-                // start = clock();
-            Status = ESEM_Sign(sk_aes, secret_key, message, signature);
-                // end = clock();
-                // SignTime = SignTime +(double)(end-start);
-            // }
-#endif
-            if (Status != ECCRYPTO_SUCCESS) {
-                printf("Problem Occurred in Sign");
-            }
-
-            // printf("%fus per sign\n", ((double) (SignTime * 1000)) / CLOCKS_PER_SEC / BENCH_LOOPS * 1000);
-            print_hex(signature, 48);
-            // SignTime = 0.0;
-        }
-        else if(userType==3){
-            printf("Server\n");
-#if defined(HIGH_SPEED)
-            Status = ESEM_Server_v2(publicAll_1, publicAll_2, publicAll_3, tempKey1, tempKey2, tempKey3);
-#else
-            Status = ESEM_Server(publicAll_1, publicAll_2, publicAll_3, tempKey1, tempKey2, tempKey3);
-#endif
-
-            printf("Three (l) different servers are simulated in a single one, so three rounds of communication happens");
-            if (Status != ECCRYPTO_SUCCESS) {
-                printf("Problem Occurred in Sign");
-            }
-        }
-        else if(userType==4){
-            printf("Verifier\n");
-            // memset(message, 1, 32);
-            ESEM_Verifier(signature, message, public_key);
-        }
-        else if(userType==5){
-            printf("Exiting\n");
-            goto cleanup;
-        }
-        else
-            goto cleanup;
-    }
-    
-    
-
-
-cleanup:
-
-
-    
-    
-    free(publicAll_1);
-    free(publicAll_2);
-    free(publicAll_3);
-
-    free(secretAll_1);
-    free(secretAll_2);
-    free(secretAll_3);
-    free(message);
-    return Status;
- 
-}
+/***********************************************************************************
+* FourQlib: a high-performance crypto library based on the elliptic curve FourQ
+*
+*    Copyright (c) Microsoft Corporation. All rights reserved.
+*
+* Abstract: testing code for cryptographic functions based on FourQ 
+************************************************************************************/   
+
+#include "../esem.h"
+ 
+#include "test_extras.h"
+#include <stdio.h>
+#include "aes.h"
+#include "aes256.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_LOOPS                      100000    // Number of iterations per bench
+#define ESEM_SERVER_WORKERS              4         // Number of worker threads behind the ROUTER/DEALER front end
+#define ESEM_SERVER_TABLES               ESEM_TABLE_PAIRS
+#define ESEM_AES_BENCH_BLOCKS            4096      // Counter blocks encrypted by ESEM_Bench_AES
+#define ESEM_STORE_PATH                  "esem.keys"   // Signer key store reused across runs, delete it to start over with new keys
+#define ESEM_SERVER_STORE_PATH           "esem.server" // Server key store: public and precomputed tables, no secrets
+
+// Benchmark and test parameters 
+#define ESEM_SIGN_BENCH_BATCH            64        // Messages per ESEM_Sign_batch call in the benchmark
+
+//For easy testing, no random keys are used in this implementation. secret_key, public_key should be generated new every time.
+ 
+void menu(){
+    printf("NOTE: Currently, our implementation only has the communication between the verifier and the server \n");
+    printf("NOTE: Therefore, Key Generation, Signer and Verifier should be run on same terminal. \n");        
+    // printf("NOTE: Before running the server, key generation should be run once. \n");        
+    printf("Select one of the following: \n");
+    printf("(1) Key Generation\n");
+    printf("(2) Signer\n");
+    printf("(3) Server\n");
+    printf("(4) Verifier\n");
+    printf("(5) Exit\n\n\n");
+
+}
+
+/**
+ * Prints the given byte array in hexadecimal format.
+ *
+ * @param data The byte array to print.
+ * @param length The length of the byte array.
+ */
+void print_hex(const unsigned char *data, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        printf("%02X", data[i]); // Prints each byte in hex format
+    }
+    printf("\n");
+}
+
+// Prints how long key generation took and the keys to share
+static void print_keygen(const struct timespec *start, const struct timespec *end, const unsigned char *public_key, const unsigned char *sk_aes)
+{
+    double elapsed = (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+
+    printf("Key generation time: %f seconds\n", elapsed);
+    printf("public_key: ");  
+    print_hex(public_key, 64);
+    printf("sk-aes: ");
+    print_hex(sk_aes, 32);
+}
+
+// Generates new keys into the arena tables, points keys at them and writes them to the key store
+static ECCRYPTO_STATUS generate_keys(unsigned char *sk_aes, unsigned char *secret_key, unsigned char *public_key, unsigned char *tempKey[ESEM_L], unsigned char *publicAll[ESEM_L], unsigned char *secretAll[ESEM_L], esem_keys_t *keys)
+{
+    struct timespec keygenStart, keygenEnd;
+    ECCRYPTO_STATUS Status;
+    unsigned int l;
+
+    clock_gettime(CLOCK_MONOTONIC, &keygenStart);
+    Status = ESEM_KeyGen(sk_aes, secret_key, public_key, publicAll[0], publicAll[1], publicAll[2], secretAll[0], secretAll[1], secretAll[2], tempKey[0], tempKey[1], tempKey[2]);
+    clock_gettime(CLOCK_MONOTONIC, &keygenEnd);
+    if (Status != ECCRYPTO_SUCCESS) {
+        printf("Problem Occurred in KeyGen");
+        return Status;
+    }
+    print_keygen(&keygenStart, &keygenEnd, public_key, sk_aes);
+
+    keys->seed = sk_aes;
+    keys->secret_key = secret_key;
+    keys->public_key = public_key;
+    for (l = 0; l < ESEM_L; l++) {
+        keys->tempKey[l] = tempKey[l];
+        keys->publicAll[l] = publicAll[l];
+        keys->secretAll[l] = secretAll[l];
+    }
+    Status = ESEM_Store_Write(ESEM_STORE_PATH, keys, NULL);
+    if (Status != ECCRYPTO_SUCCESS) {
+        printf("Problem Occurred in writing %s\n", ESEM_STORE_PATH);
+    } else {
+        printf("Keys written to %s\n", ESEM_STORE_PATH);
+    }
+    return Status;
+}
+
+
+// Whether a store holds the public tables and level keys of keys
+static int same_public_keys(const esem_keys_t *stored, const esem_keys_t *keys)
+{
+    unsigned int l;
+
+    if (memcmp(stored->public_key, keys->public_key, 64) != 0) {
+        return 0;
+    }
+    for (l = 0; l < ESEM_L; l++) {
+        if (memcmp(stored->tempKey[l], keys->tempKey[l], 32) != 0 || memcmp(stored->publicAll[l], keys->publicAll[l], BPV_N*64) != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+// Sets up the server from the server store if it holds the precomputed tables of keys. Otherwise the tables are
+// precomputed and the server store is rewritten, with the public keys only, so that the next server starts at once
+static esem_server_t *start_server(esem_arena_t *arena, const esem_keys_t *keys, esem_store_t **store)
+{
+    esem_keys_t stored, public_keys = *keys;
+    esem_server_t *server;
+    unsigned int l;
+
+    *store = ESEM_Store_Open(arena, ESEM_SERVER_STORE_PATH);
+    if (*store != NULL) {
+        ESEM_Store_Keys(*store, &stored);
+        if ((ESEM_Store_Flags(*store) & ESEM_STORE_PRECOMPUTED) && same_public_keys(&stored, keys)) {
+            printf("Server tables mapped from %s\n", ESEM_SERVER_STORE_PATH);
+            return ESEM_Server_From_Store(arena, *store, ESEM_SERVER_TABLES);
+        }
+        ESEM_Store_Close(*store);
+        *store = NULL;
+    }
+
+    server = ESEM_Server_New(arena, keys->publicAll[0], keys->publicAll[1], keys->publicAll[2], keys->tempKey[0], keys->tempKey[1], keys->tempKey[2], ESEM_SERVER_TABLES);
+    public_keys.seed = NULL;
+    public_keys.secret_key = NULL;
+    for (l = 0; l < ESEM_L; l++) {
+        public_keys.secretAll[l] = NULL;
+    }
+    if (server != NULL && ESEM_Store_Write(ESEM_SERVER_STORE_PATH, &public_keys, server) != ECCRYPTO_SUCCESS) {
+        printf("Problem Occurred in writing %s\n", ESEM_SERVER_STORE_PATH);
+    }
+    return server;
+}
+
+
+/**
+ * Compares the throughput of the AES-256 backends on the counter blocks used by key generation and the v1 signer, and
+ * of the AES-128 counter-mode kernels of aes.c. Checks that the backends, and the kernels, produce the same output.
+ */
+void ESEM_Bench_AES(void)
+{
+    aes256_context_t ctx;
+    aes256_key_t key;
+    aes256_blk_t *out[2];
+    static const char *backends[3] = {"byte-oriented:", "AES-NI:", "bitsliced:"};
+    unsigned long long cycles[2] = {0, 0}, cycles1, cycles2;
+    unsigned int i, backend;
+
+    out[0] = malloc(ESEM_AES_BENCH_BLOCKS*sizeof(aes256_blk_t));
+    out[1] = malloc(ESEM_AES_BENCH_BLOCKS*sizeof(aes256_blk_t));
+    if (out[0] == NULL || out[1] == NULL) {
+        free(out[0]);
+        free(out[1]);
+        return;
+    }
+    for (i = 0; i < 32; i++) {
+        key.raw[i] = (uint8_t)i;
+    }
+    aes256_init(&ctx, &key);
+
+    for (backend = AES256_BACKEND_BYTE; backend <= AES256_BACKEND_BITSLICED; backend++) {
+        if (aes256_set_backend(&ctx, (uint8_t)backend) != AES_SUCCESS) {
+            printf("AES-256 CTR, %-15s not available\n", backends[backend]);
+            continue;
+        }
+        cycles1 = cpucycles();
+        aes256_encrypt_ctr(&ctx, 0, ESEM_AES_BENCH_BLOCKS, out[backend != AES256_BACKEND_BYTE]);
+        cycles2 = cpucycles();
+        if (backend == AES256_BACKEND_BYTE) {
+            cycles[0] = cycles2 - cycles1;
+            printf("AES-256 CTR, %-15s %8.1f cycles/byte\n", backends[backend], (double)cycles[0]/(ESEM_AES_BENCH_BLOCKS*16));
+            continue;
+        }
+        cycles[1] = cycles2 - cycles1;
+        printf("AES-256 CTR, %-15s %8.1f cycles/byte (%.0fx)\n", backends[backend], (double)cycles[1]/(ESEM_AES_BENCH_BLOCKS*16), (double)cycles[0]/cycles[1]);
+        if (memcmp(out[0], out[1], ESEM_AES_BENCH_BLOCKS*sizeof(aes256_blk_t)) != 0) {
+            printf("AES-256 backends disagree\n");
+        }
+    }
+    aes256_done(&ctx);
+
+    free(out[0]);
+    free(out[1]);
+
+    // Counter-mode kernels of the AES-128 code (aes.c)
+    static const char *names[4] = {"AES-NI x8", "VAES-256 x16", "VAES-512 x32", "bitsliced x4"};
+    block *ref, *blocks;
+    aes_ctx actx;
+    int kernel;
+
+    ref = malloc(ESEM_AES_BENCH_BLOCKS*sizeof(block));
+    blocks = malloc(ESEM_AES_BENCH_BLOCKS*sizeof(block));
+    if (ref == NULL || blocks == NULL) {
+        free(ref);
+        free(blocks);
+        return;
+    }
+    aes_set_key(&actx, toBlock(key.raw));
+    aes_ctr_blocks_kernel(AES_KERNEL_BITSLICED, &actx, 0, ESEM_AES_BENCH_BLOCKS, ref);
+
+    for (kernel = AES_KERNEL_AESNI; kernel <= AES_KERNEL_BITSLICED; kernel++) {
+        if (!aes_ctr_kernel_available(kernel)) {
+            printf("AES-128 CTR, %-13s not available\n", names[kernel]);
+            continue;
+        }
+        cycles[0] = 0;
+        for (i = 0; i < 16; i++) {
+            cycles1 = cpucycles();
+            aes_ctr_blocks_kernel(kernel, &actx, 0, ESEM_AES_BENCH_BLOCKS, blocks);
+            cycles2 = cpucycles();
+            cycles[0] += cycles2 - cycles1;
+        }
+        printf("AES-128 CTR, %-13s %8.2f cycles/byte\n", names[kernel], (double)cycles[0]/(16*ESEM_AES_BENCH_BLOCKS*16));
+        if (memcmp(ref, blocks, ESEM_AES_BENCH_BLOCKS*sizeof(block)) != 0) {
+            printf("AES-128 CTR kernels disagree\n");
+        }
+    }
+
+    free(ref);
+    free(blocks);
+}
+
+
+int main()
+{
+    //AES Key
+    unsigned char sk_aes[32] = {0x54, 0xa2, 0xf8, 0x03, 0x1d, 0x18, 0xac, 0x77, 0xd2, 0x53, 0x92, 0xf2, 0x80, 0xb4, 0xb1, 0x2f, 0xac, 0xf1, 0x29, 0x3f, 0x3a, 0xe6, 0x77, 0x7d, 0x74, 0x15, 0x67, 0x91, 0x99, 0x53, 0x69, 0xc5}; 
+
+    //Schnorr Key
+    unsigned char secret_key[32] =  {0x54, 0xa2, 0xf8, 0x03, 0x1d, 0x18, 0xac, 0x77, 0xd2, 0x53, 0x92, 0xf2, 0x80, 0xb4, 0xb1, 0x2f, 0xac, 0xf1, 0x29, 0x3f, 0x3a, 0xe6, 0x77, 0x7d, 0x74, 0x15, 0x67, 0x91, 0x99, 0x53, 0x69, 0xc5}; 
+    unsigned char *publicAll[ESEM_L], *secretAll[ESEM_L];   // Tables of generated keys
+    unsigned char message[32] = {0}, signature[48];
+    unsigned char tempKey1[32], tempKey2[32], tempKey3[32], public_key[64]; //These are the keys to be shared with Parties.
+    unsigned char *tempKey[ESEM_L] = {tempKey1, tempKey2, tempKey3};
+    esem_keys_t keys;                                       // Keys in use: generated, or mapped from the key store
+    uint64_t counter = 0;                                   // Next signing counter. Every signer below goes on from it, so no x is reused
+    esem_store_t *store;                                    // Signer key store
+    esem_store_t *serverStore = NULL;                       // Server key store the server's tables are mapped from
+    uint64_t benchLoop;
+    benchLoop = 0;
+
+    // All the tables and contexts live in one arena
+    esem_arena_t arena;
+    size_t arenaSize = ESEM_Tables_Size() + ESEM_Signer_Size() + ESEM_Offline_Size() + ESEM_Verifier_Size(0) + ESEM_Store_Size();
+    void *arenaBuffer = malloc(arenaSize);
+    // The server has an arena of its own, emptied whenever new keys replace the server
+    esem_arena_t serverArena;
+    size_t serverArenaSize = ESEM_Server_Size(ESEM_SERVER_TABLES) + ESEM_Store_Size();
+    void *serverArenaBuffer = malloc(serverArenaSize);
+    esem_signer_t *signer;
+    esem_server_t *server = NULL;
+    esem_verifier_t *verifier = NULL;
+
+    //  Benchmarking variables 
+    double SignTime, VerifyTime;
+    SignTime = 0.0;
+    VerifyTime = 0.0;
+    clock_t start, start2;
+    clock_t end, end2; 
+    // unsigned long long cycles, cycles1, cycles2;     
+    // unsigned long long vcycles, vcycles1, vcycles2;
+
+    ECCRYPTO_STATUS Status = ECCRYPTO_SUCCESS;
+    int userType;
+#if HIGH_SPEED
+    unsigned char signature2[48];
+    esem_offline_t *offline;
+    unsigned char batchMessages[32*ESEM_SIGN_BENCH_BATCH] = {0}, batchSignatures[48*ESEM_SIGN_BENCH_BATCH];
+#endif
+
+    if (arenaBuffer == NULL || serverArenaBuffer == NULL) {
+        free(arenaBuffer);
+        free(serverArenaBuffer);
+        return ECCRYPTO_ERROR_NO_MEMORY;
+    }
+    ESEM_Arena_Init(&arena, arenaBuffer, arenaSize);
+    ESEM_Arena_Init(&serverArena, serverArenaBuffer, serverArenaSize);
+    ESEM_Tables_New(&arena, publicAll, secretAll);
+    signer = ESEM_Signer_New(&arena);
+#if HIGH_SPEED
+    offline = ESEM_Offline_New(&arena);
+#endif
+
+    modulo_order((digit_t*)secret_key, (digit_t*)secret_key);
+
+    ESEM_Bench_AES();
+
+    // Keys of an earlier run are used in place from the key store, otherwise new ones are generated and stored
+    store = ESEM_Store_Open(&arena, ESEM_STORE_PATH);
+    if (store != NULL) {
+        ESEM_Store_Keys(store, &keys);
+    }
+    if (store != NULL && keys.seed != NULL) {
+        memcpy(sk_aes, keys.seed, 32);
+        memcpy(secret_key, keys.secret_key, 32);
+        memcpy(public_key, keys.public_key, 64);
+        memcpy(tempKey1, keys.tempKey[0], 32);
+        memcpy(tempKey2, keys.tempKey[1], 32);
+        memcpy(tempKey3, keys.tempKey[2], 32);
+        printf("Keys mapped from %s\n", ESEM_STORE_PATH);
+        printf("public_key: ");
+        print_hex(public_key, 64);
+    } else {
+        if (store != NULL) {
+            ESEM_Store_Close(store);
+            store = NULL;
+        }
+        Status = generate_keys(sk_aes, secret_key, public_key, tempKey, publicAll, secretAll, &keys);
+    }
+
+#if HIGH_SPEED
+    printf("High Speed\n");
+    ESEM_Signer_Init_v2(signer, secret_key, tempKey1, tempKey2, tempKey3, counter);
+    for(benchLoop = 0; benchLoop <BENCH_LOOPS; benchLoop++){
+        start = clock();
+        Status = ESEM_Signer_Sign_v2(signer, secret_key, message, keys.secretAll[0], keys.secretAll[1], keys.secretAll[2], signature);
+        end = clock();
+        SignTime = SignTime +(double)(end-start);
+    }
+    counter = ESEM_Signer_Done(signer);
+#else 
+    ESEM_Signer_Init(signer, sk_aes, secret_key, counter);
+    for(benchLoop = 0; benchLoop <BENCH_LOOPS; benchLoop++){
+        start = clock();
+        Status = ESEM_Signer_Sign(signer, secret_key, message, signature);
+        end = clock();
+        SignTime = SignTime +(double)(end-start);
+    }
+    counter = ESEM_Signer_Done(signer);
+#endif
+    if (Status != ECCRYPTO_SUCCESS) {
+        printf("Problem Occurred in Sign");
+    }
+
+    printf("%fus per sign\n", ((double) (SignTime * 1000)) / CLOCKS_PER_SEC / BENCH_LOOPS * 1000);
+    print_hex(signature, 48);
+
+#if HIGH_SPEED
+    // The same parameters without the secret tables: secrets recomputed with the v1 PRF
+    SignTime = 0.0;
+    ESEM_Signer_Init(signer, sk_aes, secret_key, counter);
+    for(benchLoop = 0; benchLoop <BENCH_LOOPS; benchLoop++){
+        start = clock();
+        Status = ESEM_Signer_Sign(signer, secret_key, message, signature2);
+        end = clock();
+        SignTime = SignTime +(double)(end-start);
+    }
+    counter = ESEM_Signer_Done(signer);
+    printf("%fus per sign without tables (v1 PRF)\n", ((double) (SignTime * 1000)) / CLOCKS_PER_SEC / BENCH_LOOPS * 1000);
+
+    // Online part of offline/online signing: the pool is refilled outside the timed calls
+    SignTime = 0.0;
+    ESEM_Offline_Init(offline, secret_key, keys.secretAll[0], keys.secretAll[1], keys.secretAll[2], tempKey1, tempKey2, tempKey3, counter, 0);
+    for(benchLoop = 0; benchLoop <BENCH_LOOPS; benchLoop++){
+        if (benchLoop % ESEM_OFFLINE_POOL == 0) {
+            ESEM_Offline_Fill(offline);
+        }
+        start = clock();
+        Status = ESEM_Offline_Sign(offline, message, signature2);
+        end = clock();
+        SignTime = SignTime +(double)(end-start);
+    }
+    counter = ESEM_Offline_Done(offline);
+    printf("%fus per sign online, (x, r) precomputed\n", ((double) (SignTime * 1000)) / CLOCKS_PER_SEC / BENCH_LOOPS * 1000);
+
+    // Throughput of batch signing, ESEM_SIGN_BENCH_BATCH messages per call
+    SignTime = 0.0;
+    ESEM_Offline_Init(offline, secret_key, keys.secretAll[0], keys.secretAll[1], keys.secretAll[2], tempKey1, tempKey2, tempKey3, counter, 0);
+    for(benchLoop = 0; benchLoop <BENCH_LOOPS/ESEM_SIGN_BENCH_BATCH; benchLoop++){
+        start = clock();
+        Status = ESEM_Sign_batch(offline, batchMessages, ESEM_SIGN_BENCH_BATCH, batchSignatures);
+        end = clock();
+        SignTime = SignTime +(double)(end-start);
+    }
+    counter = ESEM_Offline_Done(offline);
+    printf("%fus per sign in batches of %d\n", ((double) (SignTime * 1000)) / CLOCKS_PER_SEC / (BENCH_LOOPS/ESEM_SIGN_BENCH_BATCH*ESEM_SIGN_BENCH_BATCH) * 1000, ESEM_SIGN_BENCH_BATCH);
+#endif
+
+
+    printf("This is a proof-of-concept implementation!!! \n");
+
+
+    while(1){
+        menu();
+
+        scanf ("%d",&userType);
+        if(userType==1){
+            printf("Key Generation\n");
+            Status = generate_keys(sk_aes, secret_key, public_key, tempKey, publicAll, secretAll, &keys);
+            // The server serves the old keys: drop it, and its mapping, so that option 3 sets it up again
+            server = NULL;
+            if (serverStore != NULL) {
+                ESEM_Store_Close(serverStore);
+                serverStore = NULL;
+            }
+            ESEM_Arena_Init(&serverArena, serverArenaBuffer, serverArenaSize);
+            if (store != NULL) {
+                ESEM_Store_Close(store);           // keys no longer point into it
+                store = NULL;
+            }
+        }
+        else if(userType==2){
+            printf("Signer\n");
+#if HIGH_SPEED
+            printf("High Speed\n");
+            // for(benchLoop = 0; benchLoop <BENCH_LOOPS; benchLoop++){
+                // start = clock();
+            Status = ESEM_Sign_v2(secret_key, message, keys.secretAll[0], keys.secretAll[1], keys.secretAll[2], tempKey1, tempKey2, tempKey3, counter++, signature);
+                // end = clock();
+                // SignTime = SignTime +(double)(end-start);
+            // }
+#else 
+            // for(benchLoop = 0; benchLoop <BENCH_LOOPS; benchLoop++){
+                // start = clock();
+            Status = ESEM_Sign(sk_aes, secret_key, message, counter++, signature);
+                // end = clock();
+                // SignTime = SignTime +(double)(end-start);
+            // }
+#endif
+            if (Status != ECCRYPTO_SUCCESS) {
+                printf("Problem Occurred in Sign");
+            }
+
+            // printf("%fus per sign\n", ((double) (SignTime * 1000)) / CLOCKS_PER_SEC / BENCH_LOOPS * 1000);
+            print_hex(signature, 48);
+            // SignTime = 0.0;
+        }
+        else if(userType==3){
+            printf("Server\n");
+            if (server == NULL) {
+                server = start_server(&serverArena, &keys, &serverStore);
+            }
+            if (server == NULL) {
+                Status = ECCRYPTO_ERROR_NO_MEMORY;
+            } else {
+                printf("Serving %d levels on %s with %u workers\n", ESEM_L, ESEM_SERVER_ENDPOINT, ESEM_SERVER_WORKERS);
+                Status = ESEM_Server_Pool(server, ESEM_SERVER_WORKERS);
+            }
+
+            printf("Three (l) different servers are simulated in a single one, each request names the level it is for");
+            if (Status != ECCRYPTO_SUCCESS) {
+                printf("Problem Occurred in Sign");
+            }
+        }
+        else if(userType==4){
+            printf("Verifier\n");
+            // memset(message, 1, 32);
+            if (verifier == NULL) {
+                verifier = ESEM_Verifier_New(&arena, 0);   // Single verifications only
+            }
+            Status = (verifier != NULL) ? ESEM_Verifier(verifier, signature, message, public_key) : ECCRYPTO_ERROR;
+            if (Status == ECCRYPTO_SUCCESS)
+                printf("Verified");
+            else if (Status == ECCRYPTO_ERROR_SIGNATURE_VERIFICATION)
+                printf("Not Verified");
+            else
+                printf("Problem Occurred in Verify");
+        }
+        else if(userType==5){
+            printf("Exiting\n");
+            goto cleanup;
+        }
+        else
+            goto cleanup;
+    }
+    
+    
+
+
+cleanup:
+
+
+    
+    
+    if (verifier != NULL) {
+        ESEM_Verifier_Done(verifier);
+    }
+    if (serverStore != NULL) {
+        ESEM_Store_Close(serverStore);
+    }
+    if (store != NULL) {
+        ESEM_Store_Close(store);
+    }
+    free(serverArenaBuffer);
+    free(arenaBuffer);
+    return Status;
+ 
+}
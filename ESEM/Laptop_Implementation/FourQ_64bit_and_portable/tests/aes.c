@@ -1,4 +1,7 @@
 #include "aes.h"
+#include "aes_ct64.h"
+
+#ifdef AES_HAVE_AESNI
 
 block keyGenHelper(block key, block keyRcon)
 {
@@ -9,23 +12,23 @@ block keyGenHelper(block key, block keyRcon)
 	return _mm_xor_si128(key, keyRcon);
 }
 
-void setKey(block userKey)
+void aes_set_key(aes_ctx* ctx, block userKey)
 {
-	mRoundKey[0] = userKey;
-	mRoundKey[1] = keyGenHelper(mRoundKey[0], _mm_aeskeygenassist_si128(mRoundKey[0], 0x01));
-	mRoundKey[2] = keyGenHelper(mRoundKey[1], _mm_aeskeygenassist_si128(mRoundKey[1], 0x02));
-	mRoundKey[3] = keyGenHelper(mRoundKey[2], _mm_aeskeygenassist_si128(mRoundKey[2], 0x04));
-	mRoundKey[4] = keyGenHelper(mRoundKey[3], _mm_aeskeygenassist_si128(mRoundKey[3], 0x08));
-	mRoundKey[5] = keyGenHelper(mRoundKey[4], _mm_aeskeygenassist_si128(mRoundKey[4], 0x10));
-	mRoundKey[6] = keyGenHelper(mRoundKey[5], _mm_aeskeygenassist_si128(mRoundKey[5], 0x20));
-	mRoundKey[7] = keyGenHelper(mRoundKey[6], _mm_aeskeygenassist_si128(mRoundKey[6], 0x40));
-	mRoundKey[8] = keyGenHelper(mRoundKey[7], _mm_aeskeygenassist_si128(mRoundKey[7], 0x80));
-	mRoundKey[9] = keyGenHelper(mRoundKey[8], _mm_aeskeygenassist_si128(mRoundKey[8], 0x1B));
-	mRoundKey[10] = keyGenHelper(mRoundKey[9], _mm_aeskeygenassist_si128(mRoundKey[9], 0x36));
+	ctx->rk[0] = userKey;
+	ctx->rk[1] = keyGenHelper(ctx->rk[0], _mm_aeskeygenassist_si128(ctx->rk[0], 0x01));
+	ctx->rk[2] = keyGenHelper(ctx->rk[1], _mm_aeskeygenassist_si128(ctx->rk[1], 0x02));
+	ctx->rk[3] = keyGenHelper(ctx->rk[2], _mm_aeskeygenassist_si128(ctx->rk[2], 0x04));
+	ctx->rk[4] = keyGenHelper(ctx->rk[3], _mm_aeskeygenassist_si128(ctx->rk[3], 0x08));
+	ctx->rk[5] = keyGenHelper(ctx->rk[4], _mm_aeskeygenassist_si128(ctx->rk[4], 0x10));
+	ctx->rk[6] = keyGenHelper(ctx->rk[5], _mm_aeskeygenassist_si128(ctx->rk[5], 0x20));
+	ctx->rk[7] = keyGenHelper(ctx->rk[6], _mm_aeskeygenassist_si128(ctx->rk[6], 0x40));
+	ctx->rk[8] = keyGenHelper(ctx->rk[7], _mm_aeskeygenassist_si128(ctx->rk[7], 0x80));
+	ctx->rk[9] = keyGenHelper(ctx->rk[8], _mm_aeskeygenassist_si128(ctx->rk[8], 0x1B));
+	ctx->rk[10] = keyGenHelper(ctx->rk[9], _mm_aeskeygenassist_si128(ctx->rk[9], 0x36));
 }
 
 
-void ecbEncCounterMode(uint64_t baseIdx, uint64_t blockLength, block* cyphertext) 
+static void aes_ctr_blocks_aesni(const aes_ctx* ctx, uint64_t baseIdx, uint64_t blockLength, block* cyphertext) 
 {
 	const int32_t step = 8;
 	int32_t idx = 0;
@@ -36,119 +39,308 @@ void ecbEncCounterMode(uint64_t baseIdx, uint64_t blockLength, block* cyphertext
 
 	for (; idx < length; idx += step, baseIdx += step)
 	{
-		temp[0] = _mm_xor_si128(_mm_set1_epi64x(baseIdx + 0), mRoundKey[0]);
-		temp[1] = _mm_xor_si128(_mm_set1_epi64x(baseIdx + 1), mRoundKey[0]);
-		temp[2] = _mm_xor_si128(_mm_set1_epi64x(baseIdx + 2), mRoundKey[0]);
-		temp[3] = _mm_xor_si128(_mm_set1_epi64x(baseIdx + 3), mRoundKey[0]);
-		temp[4] = _mm_xor_si128(_mm_set1_epi64x(baseIdx + 4), mRoundKey[0]);
-		temp[5] = _mm_xor_si128(_mm_set1_epi64x(baseIdx + 5), mRoundKey[0]);
-		temp[6] = _mm_xor_si128(_mm_set1_epi64x(baseIdx + 6), mRoundKey[0]);
-		temp[7] = _mm_xor_si128(_mm_set1_epi64x(baseIdx + 7), mRoundKey[0]);
-
-		temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[1]);
-		temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[1]);
-		temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[1]);
-		temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[1]);
-		temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[1]);
-		temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[1]);
-		temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[1]);
-		temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[1]);
-
-		temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[2]);
-		temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[2]);
-		temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[2]);
-		temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[2]);
-		temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[2]);
-		temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[2]);
-		temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[2]);
-		temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[2]);
-
-		temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[3]);
-		temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[3]);
-		temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[3]);
-		temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[3]);
-		temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[3]);
-		temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[3]);
-		temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[3]);
-		temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[3]);
-
-		temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[4]);
-		temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[4]);
-		temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[4]);
-		temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[4]);
-		temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[4]);
-		temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[4]);
-		temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[4]);
-		temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[4]);
-
-		temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[5]);
-		temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[5]);
-		temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[5]);
-		temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[5]);
-		temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[5]);
-		temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[5]);
-		temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[5]);
-		temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[5]);
-
-		temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[6]);
-		temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[6]);
-		temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[6]);
-		temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[6]);
-		temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[6]);
-		temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[6]);
-		temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[6]);
-		temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[6]);
-
-		temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[7]);
-		temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[7]);
-		temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[7]);
-		temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[7]);
-		temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[7]);
-		temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[7]);
-		temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[7]);
-		temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[7]);
-
-		temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[8]);
-		temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[8]);
-		temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[8]);
-		temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[8]);
-		temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[8]);
-		temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[8]);
-		temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[8]);
-		temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[8]);
-
-		temp[0] = _mm_aesenc_si128(temp[0], mRoundKey[9]);
-		temp[1] = _mm_aesenc_si128(temp[1], mRoundKey[9]);
-		temp[2] = _mm_aesenc_si128(temp[2], mRoundKey[9]);
-		temp[3] = _mm_aesenc_si128(temp[3], mRoundKey[9]);
-		temp[4] = _mm_aesenc_si128(temp[4], mRoundKey[9]);
-		temp[5] = _mm_aesenc_si128(temp[5], mRoundKey[9]);
-		temp[6] = _mm_aesenc_si128(temp[6], mRoundKey[9]);
-		temp[7] = _mm_aesenc_si128(temp[7], mRoundKey[9]);
-
-		cyphertext[idx + 0] = _mm_aesenclast_si128(temp[0], mRoundKey[10]);
-		cyphertext[idx + 1] = _mm_aesenclast_si128(temp[1], mRoundKey[10]);
-		cyphertext[idx + 2] = _mm_aesenclast_si128(temp[2], mRoundKey[10]);
-		cyphertext[idx + 3] = _mm_aesenclast_si128(temp[3], mRoundKey[10]);
-		cyphertext[idx + 4] = _mm_aesenclast_si128(temp[4], mRoundKey[10]);
-		cyphertext[idx + 5] = _mm_aesenclast_si128(temp[5], mRoundKey[10]);
-		cyphertext[idx + 6] = _mm_aesenclast_si128(temp[6], mRoundKey[10]);
-		cyphertext[idx + 7] = _mm_aesenclast_si128(temp[7], mRoundKey[10]);
+		temp[0] = _mm_xor_si128(_mm_set1_epi64x(baseIdx + 0), ctx->rk[0]);
+		temp[1] = _mm_xor_si128(_mm_set1_epi64x(baseIdx + 1), ctx->rk[0]);
+		temp[2] = _mm_xor_si128(_mm_set1_epi64x(baseIdx + 2), ctx->rk[0]);
+		temp[3] = _mm_xor_si128(_mm_set1_epi64x(baseIdx + 3), ctx->rk[0]);
+		temp[4] = _mm_xor_si128(_mm_set1_epi64x(baseIdx + 4), ctx->rk[0]);
+		temp[5] = _mm_xor_si128(_mm_set1_epi64x(baseIdx + 5), ctx->rk[0]);
+		temp[6] = _mm_xor_si128(_mm_set1_epi64x(baseIdx + 6), ctx->rk[0]);
+		temp[7] = _mm_xor_si128(_mm_set1_epi64x(baseIdx + 7), ctx->rk[0]);
+
+		temp[0] = _mm_aesenc_si128(temp[0], ctx->rk[1]);
+		temp[1] = _mm_aesenc_si128(temp[1], ctx->rk[1]);
+		temp[2] = _mm_aesenc_si128(temp[2], ctx->rk[1]);
+		temp[3] = _mm_aesenc_si128(temp[3], ctx->rk[1]);
+		temp[4] = _mm_aesenc_si128(temp[4], ctx->rk[1]);
+		temp[5] = _mm_aesenc_si128(temp[5], ctx->rk[1]);
+		temp[6] = _mm_aesenc_si128(temp[6], ctx->rk[1]);
+		temp[7] = _mm_aesenc_si128(temp[7], ctx->rk[1]);
+
+		temp[0] = _mm_aesenc_si128(temp[0], ctx->rk[2]);
+		temp[1] = _mm_aesenc_si128(temp[1], ctx->rk[2]);
+		temp[2] = _mm_aesenc_si128(temp[2], ctx->rk[2]);
+		temp[3] = _mm_aesenc_si128(temp[3], ctx->rk[2]);
+		temp[4] = _mm_aesenc_si128(temp[4], ctx->rk[2]);
+		temp[5] = _mm_aesenc_si128(temp[5], ctx->rk[2]);
+		temp[6] = _mm_aesenc_si128(temp[6], ctx->rk[2]);
+		temp[7] = _mm_aesenc_si128(temp[7], ctx->rk[2]);
+
+		temp[0] = _mm_aesenc_si128(temp[0], ctx->rk[3]);
+		temp[1] = _mm_aesenc_si128(temp[1], ctx->rk[3]);
+		temp[2] = _mm_aesenc_si128(temp[2], ctx->rk[3]);
+		temp[3] = _mm_aesenc_si128(temp[3], ctx->rk[3]);
+		temp[4] = _mm_aesenc_si128(temp[4], ctx->rk[3]);
+		temp[5] = _mm_aesenc_si128(temp[5], ctx->rk[3]);
+		temp[6] = _mm_aesenc_si128(temp[6], ctx->rk[3]);
+		temp[7] = _mm_aesenc_si128(temp[7], ctx->rk[3]);
+
+		temp[0] = _mm_aesenc_si128(temp[0], ctx->rk[4]);
+		temp[1] = _mm_aesenc_si128(temp[1], ctx->rk[4]);
+		temp[2] = _mm_aesenc_si128(temp[2], ctx->rk[4]);
+		temp[3] = _mm_aesenc_si128(temp[3], ctx->rk[4]);
+		temp[4] = _mm_aesenc_si128(temp[4], ctx->rk[4]);
+		temp[5] = _mm_aesenc_si128(temp[5], ctx->rk[4]);
+		temp[6] = _mm_aesenc_si128(temp[6], ctx->rk[4]);
+		temp[7] = _mm_aesenc_si128(temp[7], ctx->rk[4]);
+
+		temp[0] = _mm_aesenc_si128(temp[0], ctx->rk[5]);
+		temp[1] = _mm_aesenc_si128(temp[1], ctx->rk[5]);
+		temp[2] = _mm_aesenc_si128(temp[2], ctx->rk[5]);
+		temp[3] = _mm_aesenc_si128(temp[3], ctx->rk[5]);
+		temp[4] = _mm_aesenc_si128(temp[4], ctx->rk[5]);
+		temp[5] = _mm_aesenc_si128(temp[5], ctx->rk[5]);
+		temp[6] = _mm_aesenc_si128(temp[6], ctx->rk[5]);
+		temp[7] = _mm_aesenc_si128(temp[7], ctx->rk[5]);
+
+		temp[0] = _mm_aesenc_si128(temp[0], ctx->rk[6]);
+		temp[1] = _mm_aesenc_si128(temp[1], ctx->rk[6]);
+		temp[2] = _mm_aesenc_si128(temp[2], ctx->rk[6]);
+		temp[3] = _mm_aesenc_si128(temp[3], ctx->rk[6]);
+		temp[4] = _mm_aesenc_si128(temp[4], ctx->rk[6]);
+		temp[5] = _mm_aesenc_si128(temp[5], ctx->rk[6]);
+		temp[6] = _mm_aesenc_si128(temp[6], ctx->rk[6]);
+		temp[7] = _mm_aesenc_si128(temp[7], ctx->rk[6]);
+
+		temp[0] = _mm_aesenc_si128(temp[0], ctx->rk[7]);
+		temp[1] = _mm_aesenc_si128(temp[1], ctx->rk[7]);
+		temp[2] = _mm_aesenc_si128(temp[2], ctx->rk[7]);
+		temp[3] = _mm_aesenc_si128(temp[3], ctx->rk[7]);
+		temp[4] = _mm_aesenc_si128(temp[4], ctx->rk[7]);
+		temp[5] = _mm_aesenc_si128(temp[5], ctx->rk[7]);
+		temp[6] = _mm_aesenc_si128(temp[6], ctx->rk[7]);
+		temp[7] = _mm_aesenc_si128(temp[7], ctx->rk[7]);
+
+		temp[0] = _mm_aesenc_si128(temp[0], ctx->rk[8]);
+		temp[1] = _mm_aesenc_si128(temp[1], ctx->rk[8]);
+		temp[2] = _mm_aesenc_si128(temp[2], ctx->rk[8]);
+		temp[3] = _mm_aesenc_si128(temp[3], ctx->rk[8]);
+		temp[4] = _mm_aesenc_si128(temp[4], ctx->rk[8]);
+		temp[5] = _mm_aesenc_si128(temp[5], ctx->rk[8]);
+		temp[6] = _mm_aesenc_si128(temp[6], ctx->rk[8]);
+		temp[7] = _mm_aesenc_si128(temp[7], ctx->rk[8]);
+
+		temp[0] = _mm_aesenc_si128(temp[0], ctx->rk[9]);
+		temp[1] = _mm_aesenc_si128(temp[1], ctx->rk[9]);
+		temp[2] = _mm_aesenc_si128(temp[2], ctx->rk[9]);
+		temp[3] = _mm_aesenc_si128(temp[3], ctx->rk[9]);
+		temp[4] = _mm_aesenc_si128(temp[4], ctx->rk[9]);
+		temp[5] = _mm_aesenc_si128(temp[5], ctx->rk[9]);
+		temp[6] = _mm_aesenc_si128(temp[6], ctx->rk[9]);
+		temp[7] = _mm_aesenc_si128(temp[7], ctx->rk[9]);
+
+		cyphertext[idx + 0] = _mm_aesenclast_si128(temp[0], ctx->rk[10]);
+		cyphertext[idx + 1] = _mm_aesenclast_si128(temp[1], ctx->rk[10]);
+		cyphertext[idx + 2] = _mm_aesenclast_si128(temp[2], ctx->rk[10]);
+		cyphertext[idx + 3] = _mm_aesenclast_si128(temp[3], ctx->rk[10]);
+		cyphertext[idx + 4] = _mm_aesenclast_si128(temp[4], ctx->rk[10]);
+		cyphertext[idx + 5] = _mm_aesenclast_si128(temp[5], ctx->rk[10]);
+		cyphertext[idx + 6] = _mm_aesenclast_si128(temp[6], ctx->rk[10]);
+		cyphertext[idx + 7] = _mm_aesenclast_si128(temp[7], ctx->rk[10]);
 	}
 
 	for (; idx < (blockLength); ++idx, ++baseIdx)
 	{
-		cyphertext[idx] = _mm_xor_si128(_mm_set1_epi64x(baseIdx), mRoundKey[0]);
-		cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], mRoundKey[1]);
-		cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], mRoundKey[2]);
-		cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], mRoundKey[3]);
-		cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], mRoundKey[4]);
-		cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], mRoundKey[5]);
-		cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], mRoundKey[6]);
-		cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], mRoundKey[7]);
-		cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], mRoundKey[8]);
-		cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], mRoundKey[9]);
-		cyphertext[idx] = _mm_aesenclast_si128(cyphertext[idx], mRoundKey[10]);
+		cyphertext[idx] = _mm_xor_si128(_mm_set1_epi64x(baseIdx), ctx->rk[0]);
+		cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], ctx->rk[1]);
+		cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], ctx->rk[2]);
+		cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], ctx->rk[3]);
+		cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], ctx->rk[4]);
+		cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], ctx->rk[5]);
+		cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], ctx->rk[6]);
+		cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], ctx->rk[7]);
+		cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], ctx->rk[8]);
+		cyphertext[idx] = _mm_aesenc_si128(cyphertext[idx], ctx->rk[9]);
+		cyphertext[idx] = _mm_aesenclast_si128(cyphertext[idx], ctx->rk[10]);
+	}
+
+}
+
+// aes_ctr_gather with AES-NI: the blocks of all indices go through the rounds 8 at a time.
+static void aes_ctr_gather_aesni(const aes_ctx* ctx, const uint64_t* indices, uint64_t count, uint64_t width, block* cyphertext)
+{
+	const uint64_t blockLength = count * width;
+	block temp[8];
+	uint64_t idx, j, step;
+	int32_t r;
+
+	for (idx = 0; idx < blockLength; idx += step)
+	{
+		step = (blockLength - idx < 8) ? blockLength - idx : 8;
+		for (j = 0; j < step; j++)
+			temp[j] = _mm_xor_si128(_mm_set1_epi64x(indices[(idx + j) / width] + (idx + j) % width), ctx->rk[0]);
+		for (r = 1; r < 10; r++)
+			for (j = 0; j < step; j++)
+				temp[j] = _mm_aesenc_si128(temp[j], ctx->rk[r]);
+		for (j = 0; j < step; j++)
+			cyphertext[idx + j] = _mm_aesenclast_si128(temp[j], ctx->rk[10]);
 	}
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define AES_HAVE_VAES
+#endif
+
+#else
+
+void aes_set_key(aes_ctx* ctx, block userKey)
+{
+	aes_ct64_keysched(ctx->sk, (const uint8_t*)&userKey, 16);
+}
+
+#endif
+
+#ifdef AES_HAVE_VAES
 
-}
\ No newline at end of file
+// Same counter blocks as aes_ctr_blocks_aesni, two per 256-bit register and eight registers in flight.
+__attribute__((target("vaes,avx2")))
+static void aes_ctr_blocks_vaes256(const aes_ctx* ctx, uint64_t baseIdx, uint64_t blockLength, block* cyphertext)
+{
+	const int32_t step = 16;
+	uint64_t idx = 0;
+	uint64_t length = blockLength - blockLength % step;
+	__m256i rk[11], temp[8];
+	int32_t r, j;
+
+	for (r = 0; r < 11; r++)
+		rk[r] = _mm256_broadcastsi128_si256(ctx->rk[r]);
+
+	for (; idx < length; idx += step, baseIdx += step)
+	{
+		for (j = 0; j < 8; j++)
+			temp[j] = _mm256_xor_si256(_mm256_set_epi64x(baseIdx + 2*j + 1, baseIdx + 2*j + 1, baseIdx + 2*j, baseIdx + 2*j), rk[0]);
+		for (r = 1; r < 10; r++)
+			for (j = 0; j < 8; j++)
+				temp[j] = _mm256_aesenc_epi128(temp[j], rk[r]);
+		for (j = 0; j < 8; j++)
+			_mm256_storeu_si256((__m256i*)(cyphertext + idx + 2*j), _mm256_aesenclast_epi128(temp[j], rk[10]));
+	}
+
+	aes_ctr_blocks_aesni(ctx, baseIdx, blockLength - length, cyphertext + length);
+}
+
+// Same counter blocks as aes_ctr_blocks_aesni, four per 512-bit register and eight registers in flight.
+__attribute__((target("vaes,avx512f")))
+static void aes_ctr_blocks_vaes512(const aes_ctx* ctx, uint64_t baseIdx, uint64_t blockLength, block* cyphertext)
+{
+	const int32_t step = 32;
+	uint64_t idx = 0;
+	uint64_t length = blockLength - blockLength % step;
+	__m512i rk[11], temp[8];
+	int32_t r, j;
+
+	for (r = 0; r < 11; r++)
+		rk[r] = _mm512_broadcast_i32x4(ctx->rk[r]);
+
+	for (; idx < length; idx += step, baseIdx += step)
+	{
+		for (j = 0; j < 8; j++)
+			temp[j] = _mm512_xor_si512(_mm512_set_epi64(baseIdx + 4*j + 3, baseIdx + 4*j + 3, baseIdx + 4*j + 2, baseIdx + 4*j + 2,
+			                                             baseIdx + 4*j + 1, baseIdx + 4*j + 1, baseIdx + 4*j, baseIdx + 4*j), rk[0]);
+		for (r = 1; r < 10; r++)
+			for (j = 0; j < 8; j++)
+				temp[j] = _mm512_aesenc_epi128(temp[j], rk[r]);
+		for (j = 0; j < 8; j++)
+			_mm512_storeu_si512((void*)(cyphertext + idx + 4*j), _mm512_aesenclast_epi128(temp[j], rk[10]));
+	}
+
+	aes_ctr_blocks_aesni(ctx, baseIdx, blockLength - length, cyphertext + length);
+}
+
+#endif
+
+// Counter blocks of aes_ctr_gather through the constant-time bitsliced AES.
+static void aes_ctr_gather_bitsliced(const aes_ctx* ctx, const uint64_t* indices, uint64_t count, uint64_t width, block* cyphertext)
+{
+#ifdef AES_HAVE_AESNI
+	uint64_t skey[AES_CT64_SKEY_WORDS(10)];
+	aes_ct64_keysched(skey, (const uint8_t*)&ctx->rk[0], 16);	// rk[0] is the key itself
+#else
+	const uint64_t* skey = ctx->sk;
+#endif
+	uint8_t* out = (uint8_t*)cyphertext;
+	uint64_t idx, counter;
+	int32_t j;
+
+	for (idx = 0; idx < count*width; idx++) {
+		counter = indices[idx / width] + idx % width;
+		for (j = 0; j < 8; j++)
+			out[16*idx + j] = out[16*idx + 8 + j] = (uint8_t)(counter >> (8*j));
+	}
+	aes_ct64_encrypt(skey, 10, out, count*width);
+
+#ifdef AES_HAVE_AESNI
+	memset(skey, 0, sizeof(skey));
+#endif
+}
+
+int aes_ctr_kernel_available(int kernel)
+{
+	switch (kernel) {
+	case AES_KERNEL_BITSLICED:
+		return 1;
+#ifdef AES_HAVE_AESNI
+	case AES_KERNEL_AESNI:
+		return 1;
+#endif
+#ifdef AES_HAVE_VAES
+	case AES_KERNEL_VAES256:
+		return __builtin_cpu_supports("vaes") && __builtin_cpu_supports("avx2");
+	case AES_KERNEL_VAES512:
+		return __builtin_cpu_supports("vaes") && __builtin_cpu_supports("avx512f");
+#endif
+	default:
+		return 0;
+	}
+}
+
+void aes_ctr_blocks_kernel(int kernel, const aes_ctx* ctx, uint64_t baseIdx, uint64_t blockLength, block* cyphertext)
+{
+	switch (kernel) {
+#ifdef AES_HAVE_VAES
+	case AES_KERNEL_VAES256:
+		aes_ctr_blocks_vaes256(ctx, baseIdx, blockLength, cyphertext);
+		break;
+	case AES_KERNEL_VAES512:
+		aes_ctr_blocks_vaes512(ctx, baseIdx, blockLength, cyphertext);
+		break;
+#endif
+#ifdef AES_HAVE_AESNI
+	case AES_KERNEL_AESNI:
+		aes_ctr_blocks_aesni(ctx, baseIdx, blockLength, cyphertext);
+		break;
+#endif
+	default:
+		aes_ctr_gather_bitsliced(ctx, &baseIdx, 1, blockLength, cyphertext);
+		break;
+	}
+}
+
+void aes_ctr_blocks(const aes_ctx* ctx, uint64_t baseIdx, uint64_t blockLength, block* cyphertext) 
+{
+	static volatile int kernel = -1;	// Widest available kernel, looked up once
+
+	if (kernel < 0) {
+		kernel = aes_ctr_kernel_available(AES_KERNEL_VAES512) ? AES_KERNEL_VAES512 :
+		         aes_ctr_kernel_available(AES_KERNEL_VAES256) ? AES_KERNEL_VAES256 :
+		         aes_ctr_kernel_available(AES_KERNEL_AESNI) ? AES_KERNEL_AESNI : AES_KERNEL_BITSLICED;
+	}
+#ifdef AES_HAVE_AESNI
+	if (blockLength < 16) {	// Too short to fill a wide register set
+		aes_ctr_blocks_aesni(ctx, baseIdx, blockLength, cyphertext);
+		return;
+	}
+#endif
+	aes_ctr_blocks_kernel(kernel, ctx, baseIdx, blockLength, cyphertext);
+}
+
+void aes_ctr_gather(const aes_ctx* ctx, const uint64_t* indices, uint64_t count, uint64_t width, block* cyphertext)
+{
+	if (width == 0)
+		return;
+#ifdef AES_HAVE_AESNI
+	aes_ctr_gather_aesni(ctx, indices, count, width, cyphertext);
+#else
+	aes_ctr_gather_bitsliced(ctx, indices, count, width, cyphertext);
+#endif
+}
@@ -1,18 +1,62 @@
 #include <stdint.h>
 #include "params.h"
+
+// AES-NI is used when the compiler targets it (e.g. -march=native on a CPU with AES), otherwise the
+// constant-time bitsliced code of aes_ct64.c.
+#if defined(__AES__)
+#define AES_HAVE_AESNI
+#endif
+
+#ifdef AES_HAVE_AESNI
 #include <wmmintrin.h>
 #include <emmintrin.h>
 #include <smmintrin.h>
+#include <immintrin.h>
 
 typedef  __m128i block; //a block is 128-bit
-block mRoundKey[11];
+
+// AES-128 key schedule. A context is only read once the key is set, so several threads can share one.
+typedef struct {
+	block rk[11];
+} aes_ctx;
 
 static inline block toBlock(uint8_t*data) { return _mm_set_epi64x(((uint64_t*)data)[1], ((uint64_t*)data)[0]);}
 static inline block toBlockLow(uint64_t low_u64)        { return _mm_set_epi64x(0, low_u64); }
 static inline block toBlockBoth(uint64_t high_u64, uint64_t low_u64) { return _mm_set_epi64x(high_u64, low_u64); }
+#else
+#include "aes_ct64.h"
+
+typedef struct { uint64_t w[2]; } block; //a block is 128-bit, low word first
+
+// AES-128 key schedule in bitsliced form. A context is only read once the key is set, so several threads can share one.
+typedef struct {
+	uint64_t sk[AES_CT64_SKEY_WORDS(10)];
+} aes_ctx;
+
+static inline block toBlock(uint8_t*data) { block b; memcpy(&b, data, sizeof(b)); return b; }
+static inline block toBlockLow(uint64_t low_u64)        { block b = {{low_u64, 0}}; return b; }
+static inline block toBlockBoth(uint64_t high_u64, uint64_t low_u64) { block b = {{low_u64, high_u64}}; return b; }
+#endif
+
+// Expands userKey into the round keys of ctx.
+void aes_set_key(aes_ctx* ctx, block userKey);
+
+// Encrypts the vector of blocks {baseIdx, baseIdx + 1, ..., baseIdx + length - 1} under ctx
+// and writes the result to cyphertext. Uses the widest kernel the CPU supports.
+void aes_ctr_blocks(const aes_ctx* ctx, uint64_t baseIdx, uint64_t length, block* cyphertext);
+
+// Encrypts width consecutive counter blocks from each of the count indices, in one pass:
+// cyphertext[width*j + w] = AES(indices[j] + w). The indices need not be sorted or distinct.
+void aes_ctr_gather(const aes_ctx* ctx, const uint64_t* indices, uint64_t count, uint64_t width, block* cyphertext);
+
+// Counter-mode kernels. They all produce the same output.
+#define AES_KERNEL_AESNI     0	// 8 blocks in flight, 128-bit AES-NI
+#define AES_KERNEL_VAES256   1	// 16 blocks in flight, 256-bit VAES
+#define AES_KERNEL_VAES512   2	// 32 blocks in flight, 512-bit VAES
+#define AES_KERNEL_BITSLICED 3	// 4 blocks in eight 64-bit words, constant time, no AES instructions
 
-// Encrypts the vector of blocks {baseIdx, baseIdx + 1, ..., baseIdx + length - 1} 
-// and writes the result to cyphertext.
-void ecbEncCounterMode(uint64_t baseIdx, uint64_t length, block* cyphertext);
-void setKey(block userKey);
+// Returns 1 if the CPU (and the compiler) support the given kernel.
+int aes_ctr_kernel_available(int kernel);
 
+// aes_ctr_blocks with a given kernel, which must be available.
+void aes_ctr_blocks_kernel(int kernel, const aes_ctx* ctx, uint64_t baseIdx, uint64_t length, block* cyphertext);
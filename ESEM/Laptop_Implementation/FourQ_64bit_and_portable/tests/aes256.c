@@ -20,6 +20,8 @@
 // OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
 #include "aes256.h"
+#include "aes256_ni.h"
+#include "aes_ct64.h"
 #ifndef NULL
 #define NULL ((void *)0)
 #endif
@@ -375,6 +377,19 @@ expandDecKey(uint8_t *k, uint8_t *rc)
     k[3] ^= rj_sbox(k[28]);
 } // expandDecKey
 
+// -----------------------------------------------------------------------------
+static uint8_t
+aes256_backend_aesni(void)
+{
+    static volatile int available = -1;     // CPUID is only queried once
+
+    if (available < 0) {
+        available = aes256_ni_available();
+    }
+
+    return (uint8_t)available;
+} // aes256_backend_aesni
+
 // -----------------------------------------------------------------------------
 uint8_t
 aes256_init(aes256_context_t *ctx, aes256_key_t *key)
@@ -389,9 +404,41 @@ aes256_init(aes256_context_t *ctx, aes256_key_t *key)
         expandEncKey(ctx->deckey.raw, &rcon);
     }
 
+    if (AES_SUCCESS != aes256_set_backend(ctx, AES256_BACKEND_AESNI)) {
+        aes256_set_backend(ctx, AES256_BACKEND_BITSLICED);
+    }
+
     return AES_SUCCESS;
 } // aes256_init
 
+// -----------------------------------------------------------------------------
+uint8_t
+aes256_set_backend(aes256_context_t *ctx, uint8_t backend)
+{
+    if (NULL == ctx) {
+        return AES_ERROR;
+    }
+
+    switch (backend) {
+    case AES256_BACKEND_AESNI:
+        if (!aes256_backend_aesni()) {
+            return AES_ERROR;
+        }
+        aes256_ni_expand(ctx->enckey.raw, ctx->rk);
+        break;
+    case AES256_BACKEND_BITSLICED:
+        aes_ct64_keysched(ctx->sk, ctx->enckey.raw, sizeof(ctx->enckey.raw));
+        break;
+    case AES256_BACKEND_BYTE:
+        break;
+    default:
+        return AES_ERROR;
+    }
+    ctx->backend = backend;
+
+    return AES_SUCCESS;
+} // aes256_set_backend
+
 
 // -----------------------------------------------------------------------------
 uint8_t
@@ -401,6 +448,12 @@ aes256_done(aes256_context_t *ctx)
 
     if (NULL != ctx) {
         ctx->key = ctx->enckey = ctx->deckey = zero;
+        for (size_t i = 0; i < sizeof(ctx->rk); i++) {
+            ctx->rk[i] = 0;
+        }
+        for (size_t i = 0; i < sizeof(ctx->sk)/sizeof(ctx->sk[0]); i++) {
+            ctx->sk[i] = 0;
+        }
         return AES_SUCCESS;
     }
 
@@ -416,6 +469,15 @@ aes256_encrypt_ecb(aes256_context_t *ctx, aes256_blk_t *buf)
         return AES_ERROR;
     }
 
+    if (AES256_BACKEND_AESNI == ctx->backend) {
+        aes256_ni_encrypt(ctx->rk, buf->raw, 1);
+        return AES_SUCCESS;
+    }
+    if (AES256_BACKEND_BITSLICED == ctx->backend) {
+        aes_ct64_encrypt(ctx->sk, 14, buf->raw, 1);
+        return AES_SUCCESS;
+    }
+
     uint8_t rcon = 1;
     addRoundKey_cpy(buf->raw, ctx->enckey.raw, ctx->key.raw);
 
@@ -439,6 +501,66 @@ aes256_encrypt_ecb(aes256_context_t *ctx, aes256_blk_t *buf)
     return AES_SUCCESS;
 } // aes256_encrypt
 
+// -----------------------------------------------------------------------------
+uint8_t
+aes256_encrypt_ctr(aes256_context_t *ctx, uint64_t base, size_t nblocks, aes256_blk_t *out)
+{
+    if ((NULL == ctx) || ((NULL == out) && (nblocks > 0))) {
+        return AES_ERROR;
+    }
+
+    if (AES256_BACKEND_AESNI == ctx->backend) {
+        aes256_ni_ctr(ctx->rk, base, nblocks, out->raw);
+        return AES_SUCCESS;
+    }
+
+    for (size_t i = 0; i < nblocks; i++) {
+        for (uint8_t j = 0; j < 16; j++) {
+            out[i].raw[j] = (j < 8) ? (uint8_t)((base + i) >> (8*j)) : 0;
+        }
+        if (AES256_BACKEND_BITSLICED != ctx->backend) {
+            aes256_encrypt_ecb(ctx, &out[i]);
+        }
+    }
+    if (AES256_BACKEND_BITSLICED == ctx->backend) {
+        aes_ct64_encrypt(ctx->sk, 14, out->raw, nblocks);
+    }
+
+    return AES_SUCCESS;
+} // aes256_encrypt_ctr
+
+// -----------------------------------------------------------------------------
+uint8_t
+aes256_encrypt_ctr_gather(aes256_context_t *ctx, const uint64_t *bases, size_t count, size_t width, aes256_blk_t *out)
+{
+    size_t nblocks = count*width;
+
+    if ((NULL == ctx) || (((NULL == out) || (NULL == bases)) && (nblocks > 0))) {
+        return AES_ERROR;
+    }
+
+    if (AES256_BACKEND_AESNI == ctx->backend) {
+        aes256_ni_ctr_gather(ctx->rk, bases, count, width, out->raw);
+        return AES_SUCCESS;
+    }
+
+    for (size_t i = 0; i < nblocks; i++) {
+        uint64_t counter = bases[i / width] + i % width;
+
+        for (uint8_t j = 0; j < 16; j++) {
+            out[i].raw[j] = (j < 8) ? (uint8_t)(counter >> (8*j)) : 0;
+        }
+        if (AES256_BACKEND_BITSLICED != ctx->backend) {
+            aes256_encrypt_ecb(ctx, &out[i]);
+        }
+    }
+    if (AES256_BACKEND_BITSLICED == ctx->backend) {
+        aes_ct64_encrypt(ctx->sk, 14, out->raw, nblocks);
+    }
+
+    return AES_SUCCESS;
+} // aes256_encrypt_ctr_gather
+
 // -----------------------------------------------------------------------------
 uint8_t
 aes256_decrypt_ecb(aes256_context_t *ctx, aes256_blk_t *buf)
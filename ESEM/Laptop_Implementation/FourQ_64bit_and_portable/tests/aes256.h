@@ -22,6 +22,9 @@
 #ifndef AES256_H__
 #define AES256_H__ 1
 
+#include <stdint.h>
+#include <stddef.h>
+
 #ifndef uint8_t
 #define uint8_t  unsigned char
 #endif
@@ -36,10 +39,20 @@ extern "C" {
 typedef struct aes256_key_t { uint8_t raw[32]; } aes256_key_t;
 typedef struct aes256_blk_t { uint8_t raw[16]; } aes256_blk_t;
 
+// Encryption backends. aes256_init picks AES256_BACKEND_AESNI when the CPU has
+// the AES instructions and the constant-time AES256_BACKEND_BITSLICED otherwise;
+// aes256_set_backend switches a context afterwards (e.g. to compare them).
+#define AES256_BACKEND_BYTE      (0)
+#define AES256_BACKEND_AESNI     (1)
+#define AES256_BACKEND_BITSLICED (2)
+
 typedef struct aes256_context_t {
     aes256_key_t key;
     aes256_key_t enckey;
     aes256_key_t deckey;
+    uint8_t rk[240];            // AES-NI round keys
+    uint64_t sk[120];           // bitsliced round keys
+    uint8_t backend;
 } aes256_context_t;
 
 
@@ -54,6 +67,16 @@ uint8_t aes256_init(
     aes256_key_t *key
 );
 
+/// @brief Select the backend of an initialized context.
+/// @param[in,out] ctx Pointer to an initialized context structure.
+/// @param[in] backend One of the AES256_BACKEND_* values.
+/// @return AES_SUCCESS on success, AES_ERROR if the backend is not available.
+///
+uint8_t aes256_set_backend(
+    aes256_context_t *ctx,
+    uint8_t backend
+);
+
 /// @brief Clear the context structure.
 /// @param[in,out] ctx Pointer to a context structure.
 /// @return AES_SUCCESS on success, AES_ERROR on failure.
@@ -82,6 +105,38 @@ uint8_t aes256_decrypt_ecb(
     aes256_blk_t *buf
 );
 
+/// @brief Encrypt nblocks consecutive counter blocks.
+/// @param[in] ctx Pointer to an initialized context structure.
+/// @param[in] base Counter of the first block. Block i holds base+i as a 64-bit
+///            little-endian integer in its first 8 bytes, followed by 8 zero bytes.
+/// @param[in] nblocks Number of blocks.
+/// @param[out] out Ciphertext, nblocks blocks.
+/// @return AES_SUCCESS on success, AES_ERROR on failure.
+///
+uint8_t aes256_encrypt_ctr(
+    aes256_context_t *ctx,
+    uint64_t base,
+    size_t nblocks,
+    aes256_blk_t *out
+);
+
+/// @brief Encrypt width consecutive counter blocks from each of count bases, in one pass.
+/// @param[in] ctx Pointer to an initialized context structure.
+/// @param[in] bases Counters of the first block of each group. The bases need not be sorted or distinct.
+/// @param[in] count Number of groups.
+/// @param[in] width Blocks per group.
+/// @param[out] out Ciphertext, count*width blocks: block width*j+w is the encryption of counter
+///            bases[j]+w, in the format of aes256_encrypt_ctr.
+/// @return AES_SUCCESS on success, AES_ERROR on failure.
+///
+uint8_t aes256_encrypt_ctr_gather(
+    aes256_context_t *ctx,
+    const uint64_t *bases,
+    size_t count,
+    size_t width,
+    aes256_blk_t *out
+);
+
 #ifdef __cplusplus
 }
 #endif
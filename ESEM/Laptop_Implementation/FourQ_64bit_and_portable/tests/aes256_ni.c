@@ -0,0 +1,193 @@
+//
+// AES-NI backend for the aes256_* API (see aes256.c).
+// The key schedule is the standard 14-round AES-256 expansion, stored as
+// 15 round keys of 16 bytes.
+//
+
+#include "aes256_ni.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <cpuid.h>
+#include <wmmintrin.h>
+#include <emmintrin.h>
+
+#define AES256_NI_FN_ static inline __attribute__((target("aes,sse2")))
+
+int aes256_ni_available(void)
+{
+    unsigned int eax, ebx, ecx, edx;
+
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0) {
+        return 0;
+    }
+    return (ecx & bit_AES) != 0;
+}
+
+AES256_NI_FN_ __m128i expand_assist_1(__m128i t1, __m128i t2)
+{ // Next even round key from the previous even one and aeskeygenassist of the odd one
+    __m128i t4;
+
+    t2 = _mm_shuffle_epi32(t2, 0xff);
+    t4 = _mm_slli_si128(t1, 0x4);
+    t1 = _mm_xor_si128(t1, t4);
+    t4 = _mm_slli_si128(t4, 0x4);
+    t1 = _mm_xor_si128(t1, t4);
+    t4 = _mm_slli_si128(t4, 0x4);
+    t1 = _mm_xor_si128(t1, t4);
+    return _mm_xor_si128(t1, t2);
+}
+
+AES256_NI_FN_ __m128i expand_assist_2(__m128i t1, __m128i t3)
+{ // Next odd round key from the previous odd one and the new even one
+    __m128i t2, t4;
+
+    t4 = _mm_aeskeygenassist_si128(t1, 0x0);
+    t2 = _mm_shuffle_epi32(t4, 0xaa);
+    t4 = _mm_slli_si128(t3, 0x4);
+    t3 = _mm_xor_si128(t3, t4);
+    t4 = _mm_slli_si128(t4, 0x4);
+    t3 = _mm_xor_si128(t3, t4);
+    t4 = _mm_slli_si128(t4, 0x4);
+    t3 = _mm_xor_si128(t3, t4);
+    return _mm_xor_si128(t3, t2);
+}
+
+#define EXPAND_ROUND(i, rcon) \
+    t1 = expand_assist_1(t1, _mm_aeskeygenassist_si128(t3, rcon)); \
+    t3 = expand_assist_2(t1, t3); \
+    rk[i] = t1; \
+    rk[i+1] = t3;
+
+__attribute__((target("aes,sse2")))
+void aes256_ni_expand(const uint8_t *key, uint8_t *round_keys)
+{
+    __m128i rk[15], t1, t3;
+    int i;
+
+    t1 = _mm_loadu_si128((const __m128i *)key);
+    t3 = _mm_loadu_si128((const __m128i *)(key + 16));
+    rk[0] = t1;
+    rk[1] = t3;
+    EXPAND_ROUND(2, 0x01);
+    EXPAND_ROUND(4, 0x02);
+    EXPAND_ROUND(6, 0x04);
+    EXPAND_ROUND(8, 0x08);
+    EXPAND_ROUND(10, 0x10);
+    EXPAND_ROUND(12, 0x20);
+    rk[14] = expand_assist_1(t1, _mm_aeskeygenassist_si128(t3, 0x40));
+
+    for (i = 0; i < 15; i++) {
+        _mm_storeu_si128((__m128i *)(round_keys + 16*i), rk[i]);
+    }
+}
+
+AES256_NI_FN_ void load_round_keys(const uint8_t *round_keys, __m128i *rk)
+{
+    int i;
+
+    for (i = 0; i < 15; i++) {
+        rk[i] = _mm_loadu_si128((const __m128i *)(round_keys + 16*i));
+    }
+}
+
+__attribute__((target("aes,sse2")))
+void aes256_ni_encrypt(const uint8_t *round_keys, uint8_t *buf, size_t nblocks)
+{
+    __m128i rk[15], b;
+    size_t i;
+    int r;
+
+    load_round_keys(round_keys, rk);
+    for (i = 0; i < nblocks; i++) {
+        b = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(buf + 16*i)), rk[0]);
+        for (r = 1; r < 14; r++) {
+            b = _mm_aesenc_si128(b, rk[r]);
+        }
+        b = _mm_aesenclast_si128(b, rk[14]);
+        _mm_storeu_si128((__m128i *)(buf + 16*i), b);
+    }
+}
+
+__attribute__((target("aes,sse2")))
+void aes256_ni_ctr(const uint8_t *round_keys, uint64_t base, size_t nblocks, uint8_t *out)
+{ // Eight independent blocks per round key keep the AES units busy, as in ecbEncCounterMode (aes.c)
+    __m128i rk[15], t[8];
+    size_t i = 0;
+    int j, r;
+
+    load_round_keys(round_keys, rk);
+    for (; i + 8 <= nblocks; i += 8) {
+        for (j = 0; j < 8; j++) {
+            t[j] = _mm_xor_si128(_mm_set_epi64x(0, (long long)(base + i + j)), rk[0]);
+        }
+        for (r = 1; r < 14; r++) {
+            for (j = 0; j < 8; j++) {
+                t[j] = _mm_aesenc_si128(t[j], rk[r]);
+            }
+        }
+        for (j = 0; j < 8; j++) {
+            _mm_storeu_si128((__m128i *)(out + 16*(i + j)), _mm_aesenclast_si128(t[j], rk[14]));
+        }
+    }
+    for (; i < nblocks; i++) {
+        t[0] = _mm_xor_si128(_mm_set_epi64x(0, (long long)(base + i)), rk[0]);
+        for (r = 1; r < 14; r++) {
+            t[0] = _mm_aesenc_si128(t[0], rk[r]);
+        }
+        _mm_storeu_si128((__m128i *)(out + 16*i), _mm_aesenclast_si128(t[0], rk[14]));
+    }
+}
+
+__attribute__((target("aes,sse2")))
+void aes256_ni_ctr_gather(const uint8_t *round_keys, const uint64_t *bases, size_t count, size_t width, uint8_t *out)
+{ // The blocks of all bases go through the rounds eight at a time, as in aes256_ni_ctr
+    __m128i rk[15], t[8];
+    size_t i, j, step, nblocks = count*width;
+    int r;
+
+    load_round_keys(round_keys, rk);
+    for (i = 0; i < nblocks; i += step) {
+        step = (nblocks - i < 8) ? nblocks - i : 8;
+        for (j = 0; j < step; j++) {
+            t[j] = _mm_xor_si128(_mm_set_epi64x(0, (long long)(bases[(i + j)/width] + (i + j) % width)), rk[0]);
+        }
+        for (r = 1; r < 14; r++) {
+            for (j = 0; j < step; j++) {
+                t[j] = _mm_aesenc_si128(t[j], rk[r]);
+            }
+        }
+        for (j = 0; j < step; j++) {
+            _mm_storeu_si128((__m128i *)(out + 16*(i + j)), _mm_aesenclast_si128(t[j], rk[14]));
+        }
+    }
+}
+
+#else
+
+int aes256_ni_available(void)
+{
+    return 0;
+}
+
+void aes256_ni_expand(const uint8_t *key, uint8_t *round_keys)
+{
+    (void)key; (void)round_keys;
+}
+
+void aes256_ni_encrypt(const uint8_t *round_keys, uint8_t *buf, size_t nblocks)
+{
+    (void)round_keys; (void)buf; (void)nblocks;
+}
+
+void aes256_ni_ctr(const uint8_t *round_keys, uint64_t base, size_t nblocks, uint8_t *out)
+{
+    (void)round_keys; (void)base; (void)nblocks; (void)out;
+}
+
+void aes256_ni_ctr_gather(const uint8_t *round_keys, const uint64_t *bases, size_t count, size_t width, uint8_t *out)
+{
+    (void)round_keys; (void)bases; (void)count; (void)width; (void)out;
+}
+
+#endif
@@ -0,0 +1,29 @@
+//
+// AES-NI backend for the aes256_* API. Only called by aes256.c once
+// aes256_ni_available() has reported hardware support.
+//
+
+#ifndef AES256_NI_H__
+#define AES256_NI_H__ 1
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Returns 1 if the CPU supports the AES instructions
+int aes256_ni_available(void);
+
+// Expands a 32-byte key into the 15 round keys (240 bytes) of AES-256
+void aes256_ni_expand(const uint8_t *key, uint8_t *round_keys);
+
+// Encrypts nblocks 16-byte blocks of buf in place (ECB)
+void aes256_ni_encrypt(const uint8_t *round_keys, uint8_t *buf, size_t nblocks);
+
+// Writes the encryption of the counter blocks base, ..., base+nblocks-1 to out. Block i holds
+// base+i as a 64-bit little-endian integer in its first 8 bytes, followed by 8 zero bytes.
+void aes256_ni_ctr(const uint8_t *round_keys, uint64_t base, size_t nblocks, uint8_t *out);
+
+// Writes the encryption of width consecutive counter blocks from each of the count bases to out:
+// block width*j + w holds bases[j] + w, in the format of aes256_ni_ctr.
+void aes256_ni_ctr_gather(const uint8_t *round_keys, const uint64_t *bases, size_t count, size_t width, uint8_t *out);
+
+#endif // AES256_NI_H__
@@ -0,0 +1,26 @@
+//
+// Constant-time bitsliced AES for targets without AES instructions.
+//
+// Four blocks are processed at a time in eight 64-bit words, following the
+// "ct64" construction of BearSSL (Thomas Pornin) with the S-box circuit of
+// Boyar and Peralta. There are no table lookups and no secret-dependent
+// branches or memory accesses.
+//
+
+#ifndef AES_CT64_H__
+#define AES_CT64_H__ 1
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define AES_CT64_SKEY_WORDS(num_rounds)  (8*((num_rounds) + 1))
+#define AES_CT64_MAX_SKEY_WORDS          AES_CT64_SKEY_WORDS(14)
+
+// Expands a 16- or 32-byte key into bitsliced round keys, AES_CT64_SKEY_WORDS(rounds) words.
+// Returns the number of rounds (10 or 14), or 0 for any other key length.
+unsigned aes_ct64_keysched(uint64_t *skey, const uint8_t *key, size_t key_len);
+
+// Encrypts nblocks 16-byte blocks of buf in place (ECB), four at a time.
+void aes_ct64_encrypt(const uint64_t *skey, unsigned num_rounds, uint8_t *buf, size_t nblocks);
+
+#endif // AES_CT64_H__
@@ -0,0 +1,183 @@
+/***********************************************************************************
+* Abstract: known-answer tests and benchmarks for the vendored BLAKE2b
+************************************************************************************/   
+
+#include "../FourQ_api.h"
+#include "../../blake2b/blake2b.h"
+#include "../FourQ_params.h"
+#include "test_extras.h"
+#include <stdio.h>
+#include <string.h>
+
+
+// Benchmark parameters
+#define BENCH_LOOPS           100000     // Number of iterations per bench
+#define TEST_LOOPS            1000       // Number of iterations per test
+
+
+static void from_hex(const char *hex, unsigned char *out, size_t len)
+{ // Decodes 2*len hex digits
+    unsigned int byte;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        sscanf(hex + 2*i, "%2x", &byte);
+        out[i] = (unsigned char)byte;
+    }
+}
+
+
+bool blake2b_test()
+{ // Known answers: RFC 7693 Appendix A, the first entries of the reference package's keyed KAT (key = 00..3f, message = 00..n-1),
+  // and the ESEM shapes on the same inputs as computed by libb2
+    static const struct { size_t outlen, inlen, keylen; const char *hash; } kat[] = {
+        { 64,   0, 64, "10ebb67700b1868efb4417987acf4690ae9d972fb7a590c2f02871799aaa4786b5e996e8f0f4eb981fc214b005f42d2ff4233499391653df7aefcbc13fc51568" },
+        { 64,   1, 64, "961f6dd1e4dd30f63901690c512e78e4b45e4742ed197c3c5e45c549fd25f2e4187b0bc9fe30492b16b0d0bc4ef9b0f34c7003fac09a5ef1532e69430234cebd" },
+        { 64, 255, 64, "142709d62e28fcccd0af97fad0f8465b971e82201dc51070faa0372aa43e92484be1c1e73ba10906d5d1853db6a4106e0a7bf9800d373d6dee2d46d62ef2a461" },
+        { 16,   8, 32, "d99cc9670c25fac25e71e7209b2adecc" },
+        { 36,  16, 32, "b6960dde370cabec5abb2ebb240a9dc0e9bab65461994f557dad4eae926615ef0c6d775b" },
+        { 40,  16, 32, "f10a04a81da95369054ee304618dc6151b594c171f6b1f315c617cba95eeef3d90e722d809b56a4e" },
+        { 32,  32, 16, "5b66baaab0b7ac17536ded77ad702a120f96a827baf3e26c9373de408dc9ecfc" }
+    };
+    unsigned char in[256], key[BLAKE2B_KEYBYTES], out[BLAKE2B_OUTBYTES], expected[BLAKE2B_OUTBYTES];
+    unsigned int n;
+    int passed;
+
+    printf("\n--------------------------------------------------------------------------------------------------------\n\n"); 
+    printf("Testing BLAKE2b: \n\n"); 
+
+    for (n = 0; n < sizeof(in); n++) {
+        in[n] = (unsigned char)n;
+    }
+    for (n = 0; n < sizeof(key); n++) {
+        key[n] = (unsigned char)n;
+    }
+
+    // Generic interface
+    passed = 1;
+    from_hex("ba80a53f981c4d0d6a2797b69f12f6e94c212f14685ac4b74b12bb6fdbffa2d17d87c5392aab792dc252d5de4533cc9518d38aa8dbf1925ab92386edd4009923", expected, 64);
+    if (blake2b(out, "abc", NULL, 64, 3, 0) != 0 || memcmp(out, expected, 64) != 0) passed = 0;
+    for (n = 0; n < sizeof(kat)/sizeof(kat[0]); n++) {
+        from_hex(kat[n].hash, expected, kat[n].outlen);
+        if (blake2b(out, in, key, kat[n].outlen, kat[n].inlen, kat[n].keylen) != 0 || memcmp(out, expected, kat[n].outlen) != 0) passed = 0;
+    }
+    if (blake2b(out, in, key, 65, 1, 32) != -1 || blake2b(out, in, key, 32, 1, 65) != -1) passed = 0;
+    if (passed==1) printf("  BLAKE2b known-answer tests .............................................................. PASSED");
+    else { printf("  BLAKE2b known-answer tests ... FAILED"); printf("\n"); return false; }
+    printf("\n");
+
+    // Fixed shapes, same answers as the generic interface
+    passed = 1;
+    from_hex(kat[3].hash, expected, 16);
+    blake2b_16_8_32(out, in, key);
+    if (memcmp(out, expected, 16) != 0) passed = 0;
+    from_hex(kat[4].hash, expected, 36);
+    blake2b_36_16_32(out, in, key);
+    if (memcmp(out, expected, 36) != 0) passed = 0;
+    from_hex(kat[5].hash, expected, 40);
+    blake2b_40_16_32(out, in, key);
+    if (memcmp(out, expected, 40) != 0) passed = 0;
+    from_hex(kat[6].hash, expected, 32);
+    blake2b_32_32_16(out, in, key);
+    if (memcmp(out, expected, 32) != 0) passed = 0;
+    if (passed==1) printf("  BLAKE2b fixed-shape tests ............................................................... PASSED");
+    else { printf("  BLAKE2b fixed-shape tests ... FAILED"); printf("\n"); return false; }
+    printf("\n");
+
+    // Midstates and four-way hashing, against the generic interface on the same keys and messages
+    passed = 1;
+    for (n = 0; n < TEST_LOOPS; n++) {
+        blake2b_midstate_t state[4];
+        const blake2b_midstate_t *states[4] = { &state[0], &state[1], &state[2], &state[3] };
+        unsigned char lanes[4][BLAKE2B_OUTBYTES];
+        unsigned char *outs[4] = { lanes[0], lanes[1], lanes[2], lanes[3] };
+        const unsigned char *ins[4], *keys[4];
+        size_t outlen = 1 + n % BLAKE2B_OUTBYTES, inlen = 1 + (7*n) % BLAKE2B_BLOCKBYTES, keylen = 1 + (13*n) % BLAKE2B_KEYBYTES;
+        unsigned int j;
+
+        for (j = 0; j < 4; j++) {
+            ins[j] = in + (n + 31*j) % (sizeof(in) - inlen);
+            keys[j] = in + (3*n + 17*j) % (sizeof(in) - keylen);
+            if (blake2b_midstate_init(&state[j], keys[j], outlen, keylen) != 0) passed = 0;
+        }
+        if (blake2b_midstate_hash_x4(states, outs, ins, inlen) != 0) passed = 0;
+        for (j = 0; j < 4; j++) {
+            blake2b(expected, ins[j], keys[j], outlen, inlen, keylen);
+            if (memcmp(lanes[j], expected, outlen) != 0) passed = 0;
+            blake2b_midstate_hash(&state[j], out, ins[j], inlen);
+            if (memcmp(out, expected, outlen) != 0) passed = 0;
+        }
+        if (blake2b_x4(outs, ins, keys, outlen, inlen, keylen) != 0) passed = 0;
+        for (j = 0; j < 4; j++) {
+            blake2b(expected, ins[j], keys[j], outlen, inlen, keylen);
+            if (memcmp(lanes[j], expected, outlen) != 0) passed = 0;
+        }
+    }
+    if (passed==1) printf("  BLAKE2b midstate and four-way tests ..................................................... PASSED");
+    else { printf("  BLAKE2b midstate and four-way tests ... FAILED"); printf("\n"); return false; }
+    printf("\n");
+
+    return true;
+}
+
+
+bool blake2b_run()
+{
+    unsigned int n;
+    unsigned long long cycles, cycles1, cycles2;
+    unsigned char in[32] = {0}, key[32] = {0}, out[40];
+
+    printf("\n--------------------------------------------------------------------------------------------------------\n\n"); 
+    printf("Benchmarking BLAKE2b \n\n"); 
+
+    cycles = 0;
+    for (n=0; n<BENCH_LOOPS; n++)
+    {
+        cycles1 = cpucycles();
+        blake2b(out, in, key, 40, 16, 32);
+        cycles2 = cpucycles();
+        cycles = cycles+(cycles2-cycles1);
+        in[0] = out[0];
+    }
+    printf("  blake2b(40, 16, 32) runs in ...                                  %8lld ", cycles/BENCH_LOOPS); print_unit;
+    printf("\n");
+
+    cycles = 0;
+    for (n=0; n<BENCH_LOOPS; n++)
+    {
+        cycles1 = cpucycles();
+        blake2b_40_16_32(out, in, key);
+        cycles2 = cpucycles();
+        cycles = cycles+(cycles2-cycles1);
+        in[0] = out[0];
+    }
+    printf("  blake2b_40_16_32 runs in ...                                     %8lld ", cycles/BENCH_LOOPS); print_unit;
+    printf("\n");
+
+    blake2b_midstate_t state;
+    blake2b_midstate_init(&state, key, 40, 32);
+    cycles = 0;
+    for (n=0; n<BENCH_LOOPS; n++)
+    {
+        cycles1 = cpucycles();
+        blake2b_midstate_hash(&state, out, in, 16);
+        cycles2 = cpucycles();
+        cycles = cycles+(cycles2-cycles1);
+        in[0] = out[0];
+    }
+    printf("  blake2b_midstate_hash (40, 16) runs in ...                       %8lld ", cycles/BENCH_LOOPS); print_unit;
+    printf("\n");
+
+    return true;
+}
+
+
+int main()
+{
+    bool OK = true;
+
+    OK = OK && blake2b_test();     // Test BLAKE2b
+    OK = OK && blake2b_run();      // Benchmark BLAKE2b
+    
+    return OK;
+}
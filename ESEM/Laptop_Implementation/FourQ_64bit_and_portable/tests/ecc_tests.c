@@ -11,6 +11,8 @@
 #include "../FourQ_tables.h"
 #include "test_extras.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 
 // Benchmark and test parameters  
@@ -115,6 +117,37 @@ bool ecc_test()
     if (passed==1) printf("  Point addition tests .................................................................... PASSED");
     else { printf("  Point addition tests ... FAILED"); printf("\n"); return false; }
     printf("\n");
+
+    {
+    point_extproj_t PP[17], TT;
+    point_t AA[17];
+    unsigned int i, sizes[4] = {0, 1, 2, 17};
+
+    // Batch point normalization
+    eccset(A); 
+    point_setup(A, P);
+
+    for (n=0; n<TEST_LOOPS/10; n++)
+    {
+        for (i=0; i<17; i++) {
+            eccdouble(P);                  // Points with unrelated Z coordinates
+            ecccopy(P, PP[i]);
+        }
+        memset(AA, 0xFF, sizeof(AA));
+        eccnorm_batch(PP, AA, sizes[n%4]);
+        if (sizes[n%4] == 0 && ((unsigned char*)AA)[0] != 0xFF) { passed=0; break; }  // An empty batch leaves Q untouched
+
+        for (i=0; i<sizes[n%4]; i++) {
+            ecccopy(PP[i], TT);
+            eccnorm(TT, A);
+            if (fp2compare64((uint64_t*)A->x,(uint64_t*)AA[i]->x)!=0 || fp2compare64((uint64_t*)A->y,(uint64_t*)AA[i]->y)!=0) { passed=0; break; }
+        }
+    }
+
+    if (passed==1) printf("  Batch point normalization tests ......................................................... PASSED");
+    else { printf("  Batch point normalization tests ... FAILED"); printf("\n"); return false; }
+    printf("\n");
+    }
    
 #if (USE_ENDO == true)
     // Psi endomorphism
@@ -284,6 +317,32 @@ bool ecc_test()
     else { printf("  Fixed-base scalar multiplication tests ... FAILED"); printf("\n"); return false; }
     printf("\n");
     }
+
+    {    
+    point_t PP[100], B; 
+    uint64_t k[100][4];
+    unsigned int i, npoints;
+
+    // Batched fixed-base scalar multiplication
+    for (n=0; n<TEST_LOOPS/50; n++)
+    {
+        npoints = 1 + (13*n)%100;              // Covers a single point, partial and several normalization batches
+        for (i=0; i<npoints; i++) {
+            random_scalar_test(k[i]); 
+        }
+        ecc_mul_fixed_batch((digit_t*)k, npoints, PP);
+
+        for (i=0; i<npoints; i++) {
+            ecc_mul_fixed((digit_t*)k[i], B);
+            if (fp2compare64((uint64_t*)B->x,(uint64_t*)PP[i]->x)!=0 || fp2compare64((uint64_t*)B->y,(uint64_t*)PP[i]->y)!=0) { passed=0; break; }
+        }
+        if (passed==0) break;
+    }
+
+    if (passed==1) printf("  Batched fixed-base scalar multiplication tests .......................................... PASSED");
+    else { printf("  Batched fixed-base scalar multiplication tests ... FAILED"); printf("\n"); return false; }
+    printf("\n");
+    }
      
     {    
     point_t PP, QQ, RR, UU, TT; 
@@ -324,6 +383,123 @@ bool ecc_test()
     printf("\n");
     }
 
+    {
+    point_t QQ, RR, UU;
+    point_precomp_t Table[NPOINTS_CACHED_TABLE];
+    uint64_t k[4], l[4], kk[4];
+
+    // Double scalar multiplication with a cached table
+    for (n=0; n<TEST_LOOPS/10; n++)
+    {
+        if (n%10 == 0) {
+            random_scalar_test(kk); 
+            eccset(QQ);
+            ecc_mul(QQ, (digit_t*)kk, QQ, false);
+            ecc_precomp_cached(QQ, Table);
+        }
+        random_scalar_test(k); 
+        random_scalar_test(l); 
+        ecc_mul_double((digit_t*)k, QQ, (digit_t*)l, RR);
+        ecc_mul_double_cached((digit_t*)k, Table, (digit_t*)l, UU);
+        
+        if (fp2compare64((uint64_t*)UU->x,(uint64_t*)RR->x)!=0 || fp2compare64((uint64_t*)UU->y,(uint64_t*)RR->y)!=0) { passed=0; break; }
+    }
+
+    if (passed==1) printf("  Double scalar multiplication with cached table tests .................................... PASSED");
+    else { printf("  Double scalar multiplication with cached table tests ... FAILED"); printf("\n"); return false; }
+    printf("\n");
+    }
+
+    {
+    point_t PP[200], RR, UU, VV;
+    point_extproj_t SS, TT;
+    point_extproj_precomp_t AA;
+    uint64_t k[200][4], kk[4];
+    static uint64_t scratch[16384];            // Caller-provided memory of ecc_mul_multi_scratch(), enough for 200 points
+    unsigned int i, npoints;
+
+    if (ecc_mul_multi_scratch_bytes(200) > sizeof(scratch)) return false;
+
+    // Multi-scalar multiplication
+    for (n=0; n<TEST_LOOPS/50; n++)
+    {
+        npoints = 1 + (37*n)%200;              // Covers a single point, partial and several chunks, and sizes above NPOINTS_MULTI_PIPPENGER
+        for (i=0; i<npoints; i++) {
+            random_scalar_test(kk); 
+            eccset(PP[i]);
+            ecc_mul(PP[i], (digit_t*)kk, PP[i], false);
+            random_scalar_test(k[i]); 
+        }
+        ecc_mul_multi(PP, (digit_t*)k, npoints, RR);
+        ecc_mul_multi_scratch(PP, (digit_t*)k, npoints, VV, scratch, sizeof(scratch));
+
+        for (i=0; i<npoints; i++) {
+            ecc_mul(PP[i], (digit_t*)k[i], UU, false);
+            point_setup(UU, TT);
+            if (i == 0) {
+                ecccopy(TT, SS);
+            } else {
+                R1_to_R2(TT, AA);
+                eccadd(AA, SS);
+            }
+        }
+        eccnorm(SS, UU);
+        
+        if (fp2compare64((uint64_t*)UU->x,(uint64_t*)RR->x)!=0 || fp2compare64((uint64_t*)UU->y,(uint64_t*)RR->y)!=0) { passed=0; break; }
+        if (fp2compare64((uint64_t*)UU->x,(uint64_t*)VV->x)!=0 || fp2compare64((uint64_t*)UU->y,(uint64_t*)VV->y)!=0) { passed=0; break; }
+    }
+
+    if (passed==1) printf("  Multi-scalar multiplication tests ....................................................... PASSED");
+    else { printf("  Multi-scalar multiplication tests ... FAILED"); printf("\n"); return false; }
+    printf("\n");
+    }
+
+#if (USE_ENDO == true)
+    {
+    point_t PP[40], RR, UU;
+    point_extproj_t SS, TT;
+    point_extproj_precomp_t AA;
+    uint64_t k[40][4], kk[4];
+    unsigned int i, c, npoints;
+    void* scratch = malloc(ecc_mul_multi_pippenger_bytes(40, W_MULTI_PIPPENGER_MAX));
+
+    if (scratch == NULL) return false;
+
+    // Multi-scalar multiplication with every Pippenger window, including those ecc_mul_multi() only picks for very large batches
+    for (n=0; n<TEST_LOOPS/100 && passed==1; n++)
+    {
+        npoints = (n & 1) ? 40 : 3;            // A few points leave most buckets empty, more fill them
+        for (i=0; i<npoints; i++) {
+            random_scalar_test(kk); 
+            eccset(PP[i]);
+            ecc_mul(PP[i], (digit_t*)kk, PP[i], false);
+            random_scalar_test(k[i]); 
+        }
+        for (i=0; i<npoints; i++) {
+            ecc_mul(PP[i], (digit_t*)k[i], UU, false);
+            point_setup(UU, TT);
+            if (i == 0) {
+                ecccopy(TT, SS);
+            } else {
+                R1_to_R2(TT, AA);
+                eccadd(AA, SS);
+            }
+        }
+        eccnorm(SS, UU);
+
+        for (c=4; c<=W_MULTI_PIPPENGER_MAX; c++) {
+            if (ecc_mul_multi_pippenger_scratch(PP, (digit_t*)k, npoints, c, RR, scratch) == false) { passed=0; break; }
+            if (fp2compare64((uint64_t*)UU->x,(uint64_t*)RR->x)!=0 || fp2compare64((uint64_t*)UU->y,(uint64_t*)RR->y)!=0) { passed=0; break; }
+        }
+    }
+    free(scratch);
+
+    if (passed==1) printf("  Multi-scalar multiplication with every Pippenger window tests ........................... PASSED");
+    else { printf("  Multi-scalar multiplication with every Pippenger window tests ... FAILED"); printf("\n"); return false; }
+    printf("\n");
+    }
+#endif
+
     return OK;
 }
 
@@ -397,6 +573,43 @@ bool ecc_run()
     }
     printf("  Point addition runs in ...                                       %8lld ", cycles/(BENCH_LOOPS*10)); print_unit;
     printf("\n");
+
+    // Point normalization
+    {
+    point_extproj_t PP[64], TT;
+    point_t AA[64];
+    unsigned int i;
+
+    eccset(A);
+    point_setup(A, P);
+    for (i=0; i<64; i++) {
+        eccdouble(P);
+        ecccopy(P, PP[i]);
+    }
+
+    cycles = 0;
+    for (n=0; n<SHORT_BENCH_LOOPS; n++)
+    {
+        ecccopy(PP[n%64], TT);
+        cycles1 = cpucycles();
+        eccnorm(TT, A);
+        cycles2 = cpucycles();
+        cycles = cycles+(cycles2-cycles1);
+    }
+    printf("  Point normalization runs in ...                                  %8lld ", cycles/SHORT_BENCH_LOOPS); print_unit;
+    printf("\n");
+
+    cycles = 0;
+    for (n=0; n<SHORT_BENCH_LOOPS/10; n++)
+    {
+        cycles1 = cpucycles();
+        eccnorm_batch(PP, AA, 64);
+        cycles2 = cpucycles();
+        cycles = cycles+(cycles2-cycles1);
+    }
+    printf("  Batch point normalization (n=64) runs in ...                     %8lld ", cycles/(SHORT_BENCH_LOOPS/10*64)); print_unit;
+    printf(" per point\n");
+    }
    
 #if (USE_ENDO == true)
     // Psi endomorphism
@@ -676,6 +889,28 @@ bool ecc_run()
     
     printf("  Fixed-base scalar mul runs in ...                                %8lld cycles with w=%d and v=%d", cycles/SHORT_BENCH_LOOPS, W_FIXEDBASE, V_FIXEDBASE);
     printf("\n"); 
+
+    // Batched fixed-base scalar multiplication  
+    {
+    point_t PP[64];
+    uint64_t k[64][4];
+    unsigned int i;
+
+    cycles = 0;
+    for (n=0; n<SHORT_BENCH_LOOPS/64; n++)
+    {        
+        for (i=0; i<64; i++) {
+            random_scalar_test(k[i]); 
+        }
+        cycles1 = cpucycles();
+        ecc_mul_fixed_batch((digit_t*)k, 64, PP);
+        cycles2 = cpucycles();
+        cycles = cycles+(cycles2-cycles1);
+    } 
+    
+    printf("  Batched fixed-base scalar mul (n=64) runs in ...                 %8lld cycles per point", cycles/((SHORT_BENCH_LOOPS/64)*64));
+    printf("\n"); 
+    }
     } 
         
     {    
@@ -701,6 +936,67 @@ bool ecc_run()
     
     printf("  Double scalar mul runs in ...                                    %8lld cycles with wP=%d and wQ=%d", cycles/SHORT_BENCH_LOOPS, WP_DOUBLEBASE, WQ_DOUBLEBASE);
     printf("\n"); 
+
+    // Double scalar multiplication with a cached table
+    point_precomp_t Table[NPOINTS_CACHED_TABLE];
+
+    cycles = 0;
+    for (n=0; n<SHORT_BENCH_LOOPS/10; n++)
+    {        
+        cycles1 = cpucycles();
+        ecc_precomp_cached(QQ, Table);
+        cycles2 = cpucycles();
+        cycles = cycles+(cycles2-cycles1);
+    }
+    
+    printf("  Cached table generation runs in ...                              %8lld ", cycles/(SHORT_BENCH_LOOPS/10)); print_unit;
+    printf("\n"); 
+
+    cycles = 0;
+    for (n=0; n<SHORT_BENCH_LOOPS; n++)
+    {        
+        random_scalar_test(k); 
+        random_scalar_test(l);  
+        cycles1 = cpucycles();
+        ecc_mul_double_cached((digit_t*)k, Table, (digit_t*)l, RR);
+        cycles2 = cpucycles();
+        cycles = cycles+(cycles2-cycles1);
+    }
+    
+    printf("  Double scalar mul with cached table runs in ...                  %8lld cycles with wP=%d and wQ=%d", cycles/SHORT_BENCH_LOOPS, WP_DOUBLEBASE, WQ_CACHEDBASE);
+    printf("\n"); 
+    }
+
+    {
+    static point_t PP[1024];
+    static uint64_t k[1024][4];
+    uint64_t kk[4];
+    point_t RR;
+    unsigned int i, npoints, loops;
+
+    // Multi-scalar multiplication
+    for (i=0; i<1024; i++) {
+        random_scalar_test(kk); 
+        eccset(PP[i]);
+        ecc_mul(PP[i], (digit_t*)kk, PP[i], false);
+        random_scalar_test(k[i]); 
+    }
+
+    for (npoints=1; npoints<=1024; npoints*=4)
+    {
+        loops = 1 + 1024/npoints;
+        cycles = 0;
+        for (n=0; n<loops; n++)
+        {        
+            cycles1 = cpucycles();
+            ecc_mul_multi(PP, (digit_t*)k, npoints, RR);
+            cycles2 = cpucycles();
+            cycles = cycles+(cycles2-cycles1);
+        }
+    
+        printf("  Multi-scalar mul (n=%4d) runs in ...                             %8lld cycles per point", npoints, cycles/(loops*npoints));
+        printf("\n"); 
+    }
     }
 
     return OK;
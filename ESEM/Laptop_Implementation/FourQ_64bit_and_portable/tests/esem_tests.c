@@ -0,0 +1,256 @@
+/***********************************************************************************
+* Abstract: tests for the ESEM verifier against a local server
+************************************************************************************/
+
+#include "../FourQ_internal.h"
+#include "../esem.h"
+#include "../../blake2b/blake2b.h"
+#include "test_extras.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+
+#define ESEM_TEST_SIGNATURES  4          // Valid, R with a point of order 2, public key with a point of order 2, wrong s
+#define ESEM_TEST_WORKERS     2
+#define ESEM_TEST_ENDPOINT    "tcp://127.0.0.1:*"   // Any free port
+
+
+static void add_order2(unsigned char *point)
+{ // P = P + (0,-1), the point of order 2: (x,y) becomes (-x,-y)
+    point_affine *P = (point_affine*)point;
+
+    fp2neg1271(P->x);
+    fp2neg1271(P->y);
+    mod1271(P->x[0]); mod1271(P->x[1]);
+    mod1271(P->y[0]); mod1271(P->y[1]);
+}
+
+
+static unsigned int times_picked(const unsigned char *signature, const unsigned char tempKey[32], unsigned int index)
+{ // How many times the level hash of the signature's x picks a table entry. A point of order 2 added to the entry
+  // only shows in R if it is picked an odd number of times
+    unsigned char hash[ESEM_HASH_BYTES];
+    blake2b_midstate_t state;
+    unsigned int i, n = 0;
+
+    blake2b_midstate_init(&state, tempKey, ESEM_HASH_BYTES, 32);
+    blake2b_midstate_hash(&state, hash, signature, 16);
+    for (i = 0; i < BPV_V; i++) {
+        n += (BPV_INDEX(hash, i) == index);
+    }
+    return n;
+}
+
+
+bool esem_sign_test()
+{ // Every signature of a signer takes a fresh counter: two messages signed in a row never share x
+    size_t size = ESEM_Tables_Size() + ESEM_Signer_Size();
+    unsigned char seed[32] = {0}, secret_key[32], public_key[64], tempKey[ESEM_L][32];
+    unsigned char *publicAll[ESEM_L], *secretAll[ESEM_L];
+    unsigned char messages[2][32] = {{0}, {1}}, signatures[2][48];
+    void *buffer = malloc(size);
+    esem_arena_t arena;
+    esem_signer_t *signer;
+    bool passed = true;
+
+    printf("\n--------------------------------------------------------------------------------------------------------\n\n");
+    printf("Testing ESEM signing: \n\n");
+
+    if (buffer == NULL) {
+        return false;
+    }
+    ESEM_Arena_Init(&arena, buffer, size);
+    ESEM_Tables_New(&arena, publicAll, secretAll);
+    signer = ESEM_Signer_New(&arena);
+    if (ESEM_KeyGen_Seeded(seed, secret_key, public_key, publicAll[0], publicAll[1], publicAll[2], secretAll[0], secretAll[1], secretAll[2], tempKey[0], tempKey[1], tempKey[2], 1) != ECCRYPTO_SUCCESS) {
+        free(buffer);
+        return false;
+    }
+
+    ESEM_Signer_Init_v2(signer, secret_key, tempKey[0], tempKey[1], tempKey[2], 0);
+    ESEM_Signer_Sign_v2(signer, secret_key, messages[0], secretAll[0], secretAll[1], secretAll[2], signatures[0]);
+    ESEM_Signer_Sign_v2(signer, secret_key, messages[1], secretAll[0], secretAll[1], secretAll[2], signatures[1]);
+    passed = passed && memcmp(signatures[0], signatures[1], 16) != 0 && ESEM_Signer_Done(signer) == 2;
+
+    ESEM_Signer_Init(signer, seed, secret_key, 0);
+    ESEM_Signer_Sign(signer, secret_key, messages[0], signatures[0]);
+    ESEM_Signer_Sign(signer, secret_key, messages[1], signatures[1]);
+    passed = passed && memcmp(signatures[0], signatures[1], 16) != 0 && ESEM_Signer_Done(signer) == 2;
+
+    ESEM_Sign_v2(secret_key, messages[0], secretAll[0], secretAll[1], secretAll[2], tempKey[0], tempKey[1], tempKey[2], 0, signatures[0]);
+    ESEM_Sign_v2(secret_key, messages[1], secretAll[0], secretAll[1], secretAll[2], tempKey[0], tempKey[1], tempKey[2], 1, signatures[1]);
+    passed = passed && memcmp(signatures[0], signatures[1], 16) != 0;
+    free(buffer);
+
+    if (passed) printf("  Fresh x for every signature .............................................................. PASSED");
+    else { printf("  Fresh x for every signature ... FAILED"); printf("\n"); return false; }
+    printf("\n");
+
+    return true;
+}
+
+
+#if HIGH_SPEED
+bool esem_sign_v1_test()
+{ // The ESEMv1 signer recomputes the secrets that ESEMv2 looks up in the tables: with the seed of the keys, both give the
+  // same signature for the same message and counter
+    size_t size = ESEM_Tables_Size();
+    unsigned char seed[32], secret_key[32], public_key[64], tempKey[ESEM_L][32];
+    unsigned char *publicAll[ESEM_L], *secretAll[ESEM_L];
+    unsigned char message[32] = {0}, signature_v1[48], signature_v2[48];
+    void *buffer = malloc(size);
+    esem_arena_t arena;
+    uint64_t counter;
+    unsigned int i;
+    bool passed = true;
+
+    printf("\n--------------------------------------------------------------------------------------------------------\n\n");
+    printf("Testing ESEMv1 signing against ESEMv2: \n\n");
+
+    if (buffer == NULL) {
+        return false;
+    }
+    for (i = 0; i < 32; i++) {
+        seed[i] = (unsigned char)(3*i + 1);
+    }
+    ESEM_Arena_Init(&arena, buffer, size);
+    ESEM_Tables_New(&arena, publicAll, secretAll);
+    if (ESEM_KeyGen_Seeded(seed, secret_key, public_key, publicAll[0], publicAll[1], publicAll[2], secretAll[0], secretAll[1], secretAll[2], tempKey[0], tempKey[1], tempKey[2], 1) != ECCRYPTO_SUCCESS) {
+        free(buffer);
+        return false;
+    }
+
+    for (counter = 0; counter < 16 && passed; counter++) {
+        message[0] = (unsigned char)counter;
+        ESEM_Sign(seed, secret_key, message, counter, signature_v1);
+        ESEM_Sign_v2(secret_key, message, secretAll[0], secretAll[1], secretAll[2], tempKey[0], tempKey[1], tempKey[2], counter, signature_v2);
+        passed = (memcmp(signature_v1, signature_v2, 48) == 0);
+    }
+    free(buffer);
+
+    if (passed) printf("  ESEM_Sign and ESEM_Sign_v2 agree ......................................................... PASSED");
+    else { printf("  ESEM_Sign and ESEM_Sign_v2 agree ... FAILED"); printf("\n"); return false; }
+    printf("\n");
+
+    return true;
+}
+#endif
+
+
+static void *serve(void *server)
+{
+    ESEM_Server_Pool((esem_server_t*)server, ESEM_TEST_WORKERS);
+    return NULL;
+}
+
+
+bool esem_test()
+{ // Single and batch verification must give the same result for every signature, including signatures whose R or
+  // public key carry a point of small order
+    size_t size = ESEM_Tables_Size() + ESEM_Signer_Size() + ESEM_Server_Size(ESEM_TABLE_NONE) + ESEM_Verifier_Size(ESEM_TEST_SIGNATURES);
+    unsigned char seed[32] = {0}, secret_key[32], public_key[64], tempKey[ESEM_L][32];
+    unsigned char *publicAll[ESEM_L], *secretAll[ESEM_L];
+    unsigned char messages[32*ESEM_TEST_SIGNATURES] = {0}, signatures[48*ESEM_TEST_SIGNATURES], public_keys[64*ESEM_TEST_SIGNATURES];
+    char endpoint[ESEM_ENDPOINT_BYTES];
+    const char *endpoints[ESEM_L];
+    static const int expected[ESEM_TEST_SIGNATURES] = {1, 1, 0, 0};
+    int valid[ESEM_TEST_SIGNATURES], single;
+    void *buffer = malloc(size);
+    esem_arena_t arena;
+    esem_signer_t *signer;
+    esem_server_t *server;
+    esem_verifier_t *verifier;
+    pthread_t thread;
+    unsigned int i, j, index;
+    bool passed = true;
+
+    printf("\n--------------------------------------------------------------------------------------------------------\n\n");
+    printf("Testing ESEM verification: \n\n");
+
+    if (buffer == NULL) {
+        return false;
+    }
+    ESEM_Arena_Init(&arena, buffer, size);
+    ESEM_Tables_New(&arena, publicAll, secretAll);
+    signer = ESEM_Signer_New(&arena);
+    if (ESEM_KeyGen_Seeded(seed, secret_key, public_key, publicAll[0], publicAll[1], publicAll[2], secretAll[0], secretAll[1], secretAll[2], tempKey[0], tempKey[1], tempKey[2], 1) != ECCRYPTO_SUCCESS) {
+        return false;
+    }
+
+    ESEM_Signer_Init_v2(signer, secret_key, tempKey[0], tempKey[1], tempKey[2], 0);
+    for (i = 0; i < ESEM_TEST_SIGNATURES; i++) {
+        messages[32*i] = (unsigned char)i;
+        ESEM_Signer_Sign_v2(signer, secret_key, messages + 32*i, secretAll[0], secretAll[1], secretAll[2], signatures + 48*i);
+        memcpy(public_keys + 64*i, public_key, 64);
+    }
+    if (ESEM_Signer_Done(signer) != ESEM_TEST_SIGNATURES) {
+        return false;
+    }
+    for (i = 0; i < ESEM_TEST_SIGNATURES; i++) {
+        for (j = 0; j < i; j++) {
+            if (memcmp(signatures + 48*i, signatures + 48*j, 16) == 0) {
+                return false;              // Each signature has its own counter, so its own x and R
+            }
+        }
+    }
+    add_order2(public_keys + 64*2);
+    signatures[48*3 + 16] ^= 1;
+
+    // The server's table of level 0 carries a point of order 2 in an entry that the second signature picks an odd
+    // number of times and the others never pick, so that only the R of the second signature carries it
+    for (index = 0; index < BPV_N; index++) {
+        if (times_picked(signatures + 48*1, tempKey[0], index) % 2 == 1 && times_picked(signatures, tempKey[0], index) == 0 &&
+            times_picked(signatures + 48*2, tempKey[0], index) == 0 && times_picked(signatures + 48*3, tempKey[0], index) == 0) {
+            break;
+        }
+    }
+    if (index == BPV_N) {
+        return false;
+    }
+    add_order2(publicAll[0] + 64*index);
+    server = ESEM_Server_New(&arena, publicAll[0], publicAll[1], publicAll[2], tempKey[0], tempKey[1], tempKey[2], ESEM_TABLE_NONE);
+    if (server == NULL || ESEM_Server_Bind(server, ESEM_TEST_ENDPOINT, endpoint, sizeof(endpoint)) != ECCRYPTO_SUCCESS ||
+        pthread_create(&thread, NULL, serve, server) != 0) {
+        return false;
+    }
+    for (i = 0; i < ESEM_L; i++) {
+        endpoints[i] = endpoint;           // The three servers are simulated by a single one
+    }
+    verifier = ESEM_Verifier_New_Endpoints(&arena, ESEM_TEST_SIGNATURES, endpoints);
+    if (verifier == NULL) {
+        return false;
+    }
+
+    if (ESEM_Verify_batch(verifier, signatures, messages, public_keys, ESEM_TEST_SIGNATURES, valid) == ECCRYPTO_ERROR) {
+        passed = false;
+    }
+    for (i = 0; i < ESEM_TEST_SIGNATURES && passed; i++) {
+        single = ESEM_Verifier(verifier, signatures + 48*i, messages + 32*i, public_keys + 64*i);
+        if (single == ECCRYPTO_ERROR || (single == ECCRYPTO_SUCCESS) != valid[i] || valid[i] != expected[i]) {
+            passed = false;
+        }
+    }
+    ESEM_Verifier_Done(verifier);
+
+    if (passed) printf("  Single and batch verification, points of small order ..................................... PASSED");
+    else { printf("  Single and batch verification, points of small order ... FAILED"); printf("\n"); return false; }
+    printf("\n");
+
+    return true;
+}
+
+
+int main()
+{
+    bool OK = true;
+
+    OK = OK && esem_sign_test();   // Test signing
+#if HIGH_SPEED
+    OK = OK && esem_sign_v1_test();   // Test the ESEMv1 signer against the tables
+#endif
+    OK = OK && esem_test();        // Test single and batch verification
+
+    return OK;
+}
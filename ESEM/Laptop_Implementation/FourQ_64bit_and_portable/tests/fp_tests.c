@@ -17,6 +17,7 @@
 #define BENCH_LOOPS       10000      // Number of iterations per bench
 #define SHORT_BENCH_LOOPS 1000       // Number of iterations per bench (for expensive operations)
 #define TEST_LOOPS        1000       // Number of iterations per test
+#define SUM_TERMS         128        // Number of terms per modular summation
 
 
 bool fp2_test()
@@ -25,6 +26,9 @@ bool fp2_test()
     int n, passed;
     f2elm_t a, b, c, d, e, f;
 	digit_t ma[NWORDS_ORDER], mb[NWORDS_ORDER], mc[NWORDS_ORDER], md[NWORDS_ORDER], me[NWORDS_ORDER], mf[NWORDS_ORDER], one[NWORDS_ORDER] = {0};
+	digit_t terms[SUM_TERMS][NWORDS_ORDER];
+	const digit_t* tables[2] = { terms[0], terms[SUM_TERMS/2] };
+	unsigned int i, indices[SUM_TERMS];
 	one[0] = 1;
 
     printf("\n--------------------------------------------------------------------------------------------------------\n\n"); 
@@ -125,6 +129,41 @@ bool fp2_test()
 	if (passed==1) printf("  Modular addition tests .......................................................................... PASSED");
 	else { printf("  Modular addition tests... FAILED"); printf("\n"); return false; }
 	printf("\n");
+
+	// Modular summation, modulo the order of a curve
+	passed = 1;
+	for (n = 0; n<TEST_LOOPS; n++)
+	{
+		memset((unsigned char*)md, 0, 32);
+		for (i = 0; i < SUM_TERMS; i++) {
+			if (i % 8 == (unsigned int)n % 8) {
+				memset((unsigned char*)terms[i], 0xFF, 32);         // Unreduced term
+			} else {
+				random_order_test(terms[i]);
+			}
+			memmove((unsigned char*)ma, (unsigned char*)terms[i], 32);
+			modulo_order(ma, ma);
+			add_mod_order(ma, md, md);                              // d = sum of the reduced terms 
+		}
+		sum_mod_order((digit_t*)terms, SUM_TERMS, me);
+		if (fp2compare64((uint64_t*)md,(uint64_t*)me)!=0) { passed=0; break; }
+
+		memset((unsigned char*)md, 0, 32);
+		for (i = 0; i < SUM_TERMS; i++) {
+			indices[i] = (i*(2*n+1) + n) % (SUM_TERMS/2);
+			memmove((unsigned char*)ma, (unsigned char*)(tables[i/(SUM_TERMS/2)] + indices[i]*NWORDS_ORDER), 32);
+			modulo_order(ma, ma);
+			add_mod_order(ma, md, md);
+		}
+		sum_mod_order_gather(tables, indices, 2, SUM_TERMS/2, me);
+		if (fp2compare64((uint64_t*)md,(uint64_t*)me)!=0) { passed=0; break; }
+
+		sum_mod_order((digit_t*)terms, 0, me);                     // Empty sum
+		if (!is_zero_ct(me, NWORDS_ORDER)) { passed=0; break; }
+	}
+	if (passed==1) printf("  Modular summation tests ......................................................................... PASSED");
+	else { printf("  Modular summation tests... FAILED"); printf("\n"); return false; }
+	printf("\n");
 	
 	// Montgomery multiplication modulo the order of the curve 
 	passed = 1;
@@ -192,7 +231,7 @@ bool fp2_run()
     int n, i;
     unsigned long long cycles, cycles1, cycles2;
     f2elm_t a, b, c;
-	digit_t ma[NWORDS_ORDER], mb[NWORDS_ORDER], mc[NWORDS_ORDER];
+	digit_t ma[NWORDS_ORDER], mb[NWORDS_ORDER], mc[NWORDS_ORDER], terms[SUM_TERMS][NWORDS_ORDER];
         
     printf("\n--------------------------------------------------------------------------------------------------------\n\n"); 
     printf("Benchmarking quadratic extension field arithmetic over GF((2^127-1)^2): \n\n"); 
@@ -294,6 +333,24 @@ bool fp2_run()
 	printf("  Addition modulo the order runs in ...... %8lld ", cycles/(BENCH_LOOPS*1000)); print_unit;
 	printf("\n");
 
+	// Summation modulo the curve order
+	cycles = 0;
+	for (n=0; n<BENCH_LOOPS; n++)
+	{
+		for (i = 0; i < SUM_TERMS; i++) {
+			random_order_test(terms[i]);
+		}
+
+		cycles1 = cpucycles();
+		for (i = 0; i < 100; i++) {
+			sum_mod_order((digit_t*)terms, SUM_TERMS, mc);
+		}
+		cycles2 = cpucycles();
+		cycles = cycles+(cycles2-cycles1);
+	}
+	printf("  Sum of %3d terms mod order runs in ..... %8lld ", SUM_TERMS, cycles/(BENCH_LOOPS*100)); print_unit;
+	printf("\n");
+
 	// Subtraction modulo the curve order
 	cycles = 0;
 	for (n = 0; n<BENCH_LOOPS; n++)
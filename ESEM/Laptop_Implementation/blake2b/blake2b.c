@@ -0,0 +1,453 @@
+/*
+BLAKE2b (RFC 7693), keyed mode, for the short inputs of ESEM.
+AVX2 compression function when the compiler targets it, portable C otherwise.
+*/
+
+#include "blake2b.h"
+#include <stdint.h>
+#include <string.h>
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#endif
+
+
+static const uint64_t blake2b_IV[8] = {
+    0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+    0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL, 0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+};
+
+static const uint8_t blake2b_sigma[12][16] = {
+    {  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+    { 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 },
+    { 11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4 },
+    {  7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8 },
+    {  9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13 },
+    {  2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9 },
+    { 12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11 },
+    { 13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10 },
+    {  6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5 },
+    { 10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13,  0 },
+    {  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+    { 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 }
+};
+
+
+static inline uint64_t load64(const uint8_t *x)
+{ // Little-endian load
+    return  (uint64_t)x[0]        | ((uint64_t)x[1] << 8)  | ((uint64_t)x[2] << 16) | ((uint64_t)x[3] << 24) |
+           ((uint64_t)x[4] << 32) | ((uint64_t)x[5] << 40) | ((uint64_t)x[6] << 48) | ((uint64_t)x[7] << 56);
+}
+
+static inline void store_output(uint8_t *out, const uint64_t h[8], size_t outlen)
+{ // First outlen bytes of the little-endian state
+    size_t i;
+
+    for (i = 0; i < outlen; i++) {
+        out[i] = (uint8_t)(h[i >> 3] >> (8*(i & 7)));
+    }
+}
+
+
+#if defined(__AVX2__)
+
+#define ROTR64_32(x)    _mm256_shuffle_epi32((x), _MM_SHUFFLE(2,3,0,1))
+#define ROTR64_24(x)    _mm256_shuffle_epi8((x), r24)
+#define ROTR64_16(x)    _mm256_shuffle_epi8((x), r16)
+#define ROTR64_63(x)    _mm256_xor_si256(_mm256_srli_epi64((x), 63), _mm256_add_epi64((x), (x)))
+
+#define G_AVX2(a, b, c, d, m0, m1)                                          \
+    a = _mm256_add_epi64(_mm256_add_epi64(a, b), m0);                       \
+    d = ROTR64_32(_mm256_xor_si256(d, a));                                  \
+    c = _mm256_add_epi64(c, d);                                             \
+    b = ROTR64_24(_mm256_xor_si256(b, c));                                  \
+    a = _mm256_add_epi64(_mm256_add_epi64(a, b), m1);                       \
+    d = ROTR64_16(_mm256_xor_si256(d, a));                                  \
+    c = _mm256_add_epi64(c, d);                                             \
+    b = ROTR64_63(_mm256_xor_si256(b, c));
+
+static inline void blake2b_compress(uint64_t h[8], const uint8_t block[BLAKE2B_BLOCKBYTES], uint64_t t, uint64_t f)
+{ // Compression function, one row of the state per register. t is the byte counter, f the last-block flag
+    const __m256i r24 = _mm256_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10, 3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10);
+    const __m256i r16 = _mm256_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9, 2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9);
+    __m256i a, b, c, d, a0, b0, m0, m1;
+    uint64_t m[16];
+    const uint8_t *s;
+    int i;
+
+    for (i = 0; i < 16; i++) {
+        m[i] = load64(block + 8*i);
+    }
+
+    a = a0 = _mm256_loadu_si256((const __m256i *)&h[0]);
+    b = b0 = _mm256_loadu_si256((const __m256i *)&h[4]);
+    c = _mm256_loadu_si256((const __m256i *)&blake2b_IV[0]);
+    d = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)&blake2b_IV[4]), _mm256_set_epi64x(0, (long long)f, 0, (long long)t));
+
+    for (i = 0; i < 12; i++) {
+        s = blake2b_sigma[i];
+        // Columns
+        m0 = _mm256_set_epi64x((long long)m[s[6]], (long long)m[s[4]], (long long)m[s[2]], (long long)m[s[0]]);
+        m1 = _mm256_set_epi64x((long long)m[s[7]], (long long)m[s[5]], (long long)m[s[3]], (long long)m[s[1]]);
+        G_AVX2(a, b, c, d, m0, m1);
+        // Diagonals
+        b = _mm256_permute4x64_epi64(b, _MM_SHUFFLE(0,3,2,1));
+        c = _mm256_permute4x64_epi64(c, _MM_SHUFFLE(1,0,3,2));
+        d = _mm256_permute4x64_epi64(d, _MM_SHUFFLE(2,1,0,3));
+        m0 = _mm256_set_epi64x((long long)m[s[14]], (long long)m[s[12]], (long long)m[s[10]], (long long)m[s[8]]);
+        m1 = _mm256_set_epi64x((long long)m[s[15]], (long long)m[s[13]], (long long)m[s[11]], (long long)m[s[9]]);
+        G_AVX2(a, b, c, d, m0, m1);
+        b = _mm256_permute4x64_epi64(b, _MM_SHUFFLE(2,1,0,3));
+        c = _mm256_permute4x64_epi64(c, _MM_SHUFFLE(1,0,3,2));
+        d = _mm256_permute4x64_epi64(d, _MM_SHUFFLE(0,3,2,1));
+    }
+
+    _mm256_storeu_si256((__m256i *)&h[0], _mm256_xor_si256(a0, _mm256_xor_si256(a, c)));
+    _mm256_storeu_si256((__m256i *)&h[4], _mm256_xor_si256(b0, _mm256_xor_si256(b, d)));
+}
+
+#define G_X4(a, b, c, d, x, y)                                              \
+    a = _mm256_add_epi64(_mm256_add_epi64(a, b), x);                        \
+    d = ROTR64_32(_mm256_xor_si256(d, a));                                  \
+    c = _mm256_add_epi64(c, d);                                             \
+    b = ROTR64_24(_mm256_xor_si256(b, c));                                  \
+    a = _mm256_add_epi64(_mm256_add_epi64(a, b), y);                        \
+    d = ROTR64_16(_mm256_xor_si256(d, a));                                  \
+    c = _mm256_add_epi64(c, d);                                             \
+    b = ROTR64_63(_mm256_xor_si256(b, c));
+
+static inline void transpose_x4(__m256i *r0, __m256i *r1, __m256i *r2, __m256i *r3)
+{ // 4x4 transpose of 64-bit words: row i becomes column i
+    __m256i t0 = _mm256_unpacklo_epi64(*r0, *r1), t1 = _mm256_unpackhi_epi64(*r0, *r1);
+    __m256i t2 = _mm256_unpacklo_epi64(*r2, *r3), t3 = _mm256_unpackhi_epi64(*r2, *r3);
+
+    *r0 = _mm256_permute2x128_si256(t0, t2, 0x20);
+    *r1 = _mm256_permute2x128_si256(t1, t3, 0x20);
+    *r2 = _mm256_permute2x128_si256(t0, t2, 0x31);
+    *r3 = _mm256_permute2x128_si256(t1, t3, 0x31);
+}
+
+static inline void blake2b_compress_x4(__m256i h[8], const uint8_t *const block[4], uint64_t t, uint64_t f)
+{ // Compression function of four independent instances, word i of instance j in lane j of h[i]. Same t and f for all
+    const __m256i r24 = _mm256_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10, 3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10);
+    const __m256i r16 = _mm256_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9, 2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9);
+    __m256i m[16], v[16];
+    const uint8_t *s;
+    int i;
+
+    for (i = 0; i < 16; i += 4) {
+        m[i]     = _mm256_loadu_si256((const __m256i *)(block[0] + 8*i));
+        m[i + 1] = _mm256_loadu_si256((const __m256i *)(block[1] + 8*i));
+        m[i + 2] = _mm256_loadu_si256((const __m256i *)(block[2] + 8*i));
+        m[i + 3] = _mm256_loadu_si256((const __m256i *)(block[3] + 8*i));
+        transpose_x4(&m[i], &m[i + 1], &m[i + 2], &m[i + 3]);
+    }
+    for (i = 0; i < 8; i++) {
+        v[i] = h[i];
+        v[i + 8] = _mm256_set1_epi64x((long long)blake2b_IV[i]);
+    }
+    v[12] = _mm256_xor_si256(v[12], _mm256_set1_epi64x((long long)t));
+    v[14] = _mm256_xor_si256(v[14], _mm256_set1_epi64x((long long)f));
+
+    for (i = 0; i < 12; i++) {
+        s = blake2b_sigma[i];
+        G_X4(v[0], v[4], v[ 8], v[12], m[s[ 0]], m[s[ 1]]);
+        G_X4(v[1], v[5], v[ 9], v[13], m[s[ 2]], m[s[ 3]]);
+        G_X4(v[2], v[6], v[10], v[14], m[s[ 4]], m[s[ 5]]);
+        G_X4(v[3], v[7], v[11], v[15], m[s[ 6]], m[s[ 7]]);
+        G_X4(v[0], v[5], v[10], v[15], m[s[ 8]], m[s[ 9]]);
+        G_X4(v[1], v[6], v[11], v[12], m[s[10]], m[s[11]]);
+        G_X4(v[2], v[7], v[ 8], v[13], m[s[12]], m[s[13]]);
+        G_X4(v[3], v[4], v[ 9], v[14], m[s[14]], m[s[15]]);
+    }
+
+    for (i = 0; i < 8; i++) {
+        h[i] = _mm256_xor_si256(h[i], _mm256_xor_si256(v[i], v[i + 8]));
+    }
+}
+
+#else
+
+#define ROTR64(x, n)    (((x) >> (n)) | ((x) << (64 - (n))))
+
+#define G(a, b, c, d, x, y)                                                 \
+    a = a + b + x;  d = ROTR64(d ^ a, 32);                                  \
+    c = c + d;      b = ROTR64(b ^ c, 24);                                  \
+    a = a + b + y;  d = ROTR64(d ^ a, 16);                                  \
+    c = c + d;      b = ROTR64(b ^ c, 63);
+
+static inline void blake2b_compress(uint64_t h[8], const uint8_t block[BLAKE2B_BLOCKBYTES], uint64_t t, uint64_t f)
+{ // Compression function. t is the byte counter, f the last-block flag
+    uint64_t m[16], v[16];
+    const uint8_t *s;
+    int i;
+
+    for (i = 0; i < 16; i++) {
+        m[i] = load64(block + 8*i);
+    }
+    for (i = 0; i < 8; i++) {
+        v[i] = h[i];
+        v[i + 8] = blake2b_IV[i];
+    }
+    v[12] ^= t;
+    v[14] ^= f;
+
+    for (i = 0; i < 12; i++) {
+        s = blake2b_sigma[i];
+        G(v[0], v[4], v[ 8], v[12], m[s[ 0]], m[s[ 1]]);
+        G(v[1], v[5], v[ 9], v[13], m[s[ 2]], m[s[ 3]]);
+        G(v[2], v[6], v[10], v[14], m[s[ 4]], m[s[ 5]]);
+        G(v[3], v[7], v[11], v[15], m[s[ 6]], m[s[ 7]]);
+        G(v[0], v[5], v[10], v[15], m[s[ 8]], m[s[ 9]]);
+        G(v[1], v[6], v[11], v[12], m[s[10]], m[s[11]]);
+        G(v[2], v[7], v[ 8], v[13], m[s[12]], m[s[13]]);
+        G(v[3], v[4], v[ 9], v[14], m[s[14]], m[s[15]]);
+    }
+
+    for (i = 0; i < 8; i++) {
+        h[i] ^= v[i] ^ v[i + 8];
+    }
+}
+
+#endif
+
+
+static inline void blake2b_init(uint64_t h[8], size_t outlen, size_t keylen)
+{ // Initial state for the parameter block (outlen, keylen, fanout 1, depth 1)
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        h[i] = blake2b_IV[i];
+    }
+    h[0] ^= 0x01010000ULL ^ ((uint64_t)keylen << 8) ^ (uint64_t)outlen;
+}
+
+
+int blake2b(void *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen)
+{
+    const uint8_t *p = (const uint8_t *)in;
+    uint8_t block[BLAKE2B_BLOCKBYTES];
+    uint64_t h[8], t = 0;
+
+    if (out == NULL || outlen == 0 || outlen > BLAKE2B_OUTBYTES || keylen > BLAKE2B_KEYBYTES || (in == NULL && inlen > 0) || (key == NULL && keylen > 0)) {
+        return -1;
+    }
+
+    blake2b_init(h, outlen, keylen);
+    if (keylen > 0) {               // The key, padded to a full block, is the first block
+        memset(block, 0, sizeof(block));
+        memcpy(block, key, keylen);
+        t = BLAKE2B_BLOCKBYTES;
+        blake2b_compress(h, block, t, (inlen == 0) ? ~0ULL : 0);
+    }
+    while (inlen > BLAKE2B_BLOCKBYTES) {
+        t += BLAKE2B_BLOCKBYTES;
+        blake2b_compress(h, p, t, 0);
+        p += BLAKE2B_BLOCKBYTES;
+        inlen -= BLAKE2B_BLOCKBYTES;
+    }
+    if (inlen > 0 || keylen == 0) { // Last block, zero padded
+        memset(block, 0, sizeof(block));
+        memcpy(block, p, inlen);
+        t += inlen;
+        blake2b_compress(h, block, t, ~0ULL);
+    }
+    store_output((uint8_t *)out, h, outlen);
+
+    memset(block, 0, sizeof(block));
+    memset(h, 0, sizeof(h));
+    return 0;
+}
+
+
+static inline void blake2b_short(unsigned char *out, size_t outlen, const unsigned char *in, size_t inlen, const unsigned char *key, size_t keylen)
+{ // Keyed BLAKE2b of a message of 1 to BLAKE2B_BLOCKBYTES bytes: the key block, then the message block. Inlined with constant lengths
+    uint8_t block[BLAKE2B_BLOCKBYTES] = {0};
+    uint64_t h[8];
+
+    blake2b_init(h, outlen, keylen);
+    memcpy(block, key, keylen);
+    blake2b_compress(h, block, BLAKE2B_BLOCKBYTES, 0);
+    memset(block, 0, keylen);
+    memcpy(block, in, inlen);
+    blake2b_compress(h, block, BLAKE2B_BLOCKBYTES + inlen, ~0ULL);
+    store_output(out, h, outlen);
+
+    memset(block, 0, sizeof(block));
+    memset(h, 0, sizeof(h));
+}
+
+
+void blake2b_16_8_32(unsigned char *out, const unsigned char *in, const unsigned char *key)
+{
+    blake2b_short(out, 16, in, 8, key, 32);
+}
+
+void blake2b_36_16_32(unsigned char *out, const unsigned char *in, const unsigned char *key)
+{
+    blake2b_short(out, 36, in, 16, key, 32);
+}
+
+void blake2b_40_16_32(unsigned char *out, const unsigned char *in, const unsigned char *key)
+{
+    blake2b_short(out, 40, in, 16, key, 32);
+}
+
+void blake2b_32_32_16(unsigned char *out, const unsigned char *in, const unsigned char *key)
+{
+    blake2b_short(out, 32, in, 32, key, 16);
+}
+
+
+static inline void blake2b_short_x4(unsigned char *const out[4], size_t outlen, const unsigned char *const in[4], size_t inlen, const unsigned char *const key[4], size_t keylen)
+{ // Four independent blake2b_short of the same shape
+#if defined(__AVX2__)
+    uint8_t block[4][BLAKE2B_BLOCKBYTES] = {{0}};
+    const uint8_t *const blocks[4] = { block[0], block[1], block[2], block[3] };
+    uint64_t h0[8], words[4][8];
+    __m256i h[8];
+    int i, j;
+
+    blake2b_init(h0, outlen, keylen);
+    for (i = 0; i < 8; i++) {
+        h[i] = _mm256_set1_epi64x((long long)h0[i]);
+    }
+    for (j = 0; j < 4; j++) {
+        memcpy(block[j], key[j], keylen);
+    }
+    blake2b_compress_x4(h, blocks, BLAKE2B_BLOCKBYTES, 0);
+    for (j = 0; j < 4; j++) {
+        memset(block[j], 0, keylen);
+        memcpy(block[j], in[j], inlen);
+    }
+    blake2b_compress_x4(h, blocks, BLAKE2B_BLOCKBYTES + inlen, ~0ULL);
+
+    transpose_x4(&h[0], &h[1], &h[2], &h[3]);
+    transpose_x4(&h[4], &h[5], &h[6], &h[7]);
+    for (j = 0; j < 4; j++) {
+        _mm256_storeu_si256((__m256i *)&words[j][0], h[j]);
+        _mm256_storeu_si256((__m256i *)&words[j][4], h[j + 4]);
+        store_output(out[j], words[j], outlen);
+    }
+
+    memset(block, 0, sizeof(block));
+    memset(words, 0, sizeof(words));
+#else
+    int j;
+
+    for (j = 0; j < 4; j++) {
+        blake2b_short(out[j], outlen, in[j], inlen, key[j], keylen);
+    }
+#endif
+}
+
+
+int blake2b_x4(unsigned char *const out[4], const unsigned char *const in[4], const unsigned char *const key[4], size_t outlen, size_t inlen, size_t keylen)
+{
+    if (outlen == 0 || outlen > BLAKE2B_OUTBYTES || inlen == 0 || inlen > BLAKE2B_BLOCKBYTES || keylen == 0 || keylen > BLAKE2B_KEYBYTES) {
+        return -1;
+    }
+    blake2b_short_x4(out, outlen, in, inlen, key, keylen);
+    return 0;
+}
+
+void blake2b_36_16_32_x4(unsigned char *const out[4], const unsigned char *const in[4], const unsigned char *const key[4])
+{
+    blake2b_short_x4(out, 36, in, 16, key, 32);
+}
+
+void blake2b_40_16_32_x4(unsigned char *const out[4], const unsigned char *const in[4], const unsigned char *const key[4])
+{
+    blake2b_short_x4(out, 40, in, 16, key, 32);
+}
+
+void blake2b_32_32_16_x4(unsigned char *const out[4], const unsigned char *const in[4], const unsigned char *const key[4])
+{
+    blake2b_short_x4(out, 32, in, 32, key, 16);
+}
+
+
+int blake2b_midstate_init(blake2b_midstate_t *state, const void *key, size_t outlen, size_t keylen)
+{
+    uint8_t block[BLAKE2B_BLOCKBYTES] = {0};
+
+    if (state == NULL || key == NULL || outlen == 0 || outlen > BLAKE2B_OUTBYTES || keylen == 0 || keylen > BLAKE2B_KEYBYTES) {
+        return -1;
+    }
+
+    blake2b_init(state->h, outlen, keylen);
+    memcpy(block, key, keylen);
+    blake2b_compress(state->h, block, BLAKE2B_BLOCKBYTES, 0);
+    state->outlen = outlen;
+
+    memset(block, 0, sizeof(block));
+    return 0;
+}
+
+
+int blake2b_midstate_hash(const blake2b_midstate_t *state, void *out, const void *in, size_t inlen)
+{
+    uint8_t block[BLAKE2B_BLOCKBYTES] = {0};
+    uint64_t h[8];
+
+    if (inlen == 0 || inlen > BLAKE2B_BLOCKBYTES) {
+        return -1;
+    }
+
+    memcpy(h, state->h, sizeof(h));
+    memcpy(block, in, inlen);
+    blake2b_compress(h, block, BLAKE2B_BLOCKBYTES + inlen, ~0ULL);
+    store_output((uint8_t *)out, h, state->outlen);
+
+    memset(block, 0, sizeof(block));
+    memset(h, 0, sizeof(h));
+    return 0;
+}
+
+
+int blake2b_midstate_hash_x4(const blake2b_midstate_t *const state[4], unsigned char *const out[4], const unsigned char *const in[4], size_t inlen)
+{
+#if defined(__AVX2__)
+    uint8_t block[4][BLAKE2B_BLOCKBYTES] = {{0}};
+    const uint8_t *const blocks[4] = { block[0], block[1], block[2], block[3] };
+    uint64_t words[4][8];
+    __m256i h[8];
+    int i, j;
+
+    if (inlen == 0 || inlen > BLAKE2B_BLOCKBYTES) {
+        return -1;
+    }
+
+    for (i = 0; i < 8; i += 4) {           // Lane j holds the state of instance j
+        for (j = 0; j < 4; j++) {
+            h[i + j] = _mm256_loadu_si256((const __m256i *)&state[j]->h[i]);
+        }
+        transpose_x4(&h[i], &h[i + 1], &h[i + 2], &h[i + 3]);
+    }
+    for (j = 0; j < 4; j++) {
+        memcpy(block[j], in[j], inlen);
+    }
+    blake2b_compress_x4(h, blocks, BLAKE2B_BLOCKBYTES + inlen, ~0ULL);
+
+    transpose_x4(&h[0], &h[1], &h[2], &h[3]);
+    transpose_x4(&h[4], &h[5], &h[6], &h[7]);
+    for (j = 0; j < 4; j++) {
+        _mm256_storeu_si256((__m256i *)&words[j][0], h[j]);
+        _mm256_storeu_si256((__m256i *)&words[j][4], h[j + 4]);
+        store_output(out[j], words[j], state[j]->outlen);
+    }
+
+    memset(block, 0, sizeof(block));
+    memset(words, 0, sizeof(words));
+    return 0;
+#else
+    int j;
+
+    if (inlen == 0 || inlen > BLAKE2B_BLOCKBYTES) {
+        return -1;
+    }
+    for (j = 0; j < 4; j++) {
+        blake2b_midstate_hash(state[j], out[j], in[j], inlen);
+    }
+    return 0;
+#endif
+}
@@ -0,0 +1,67 @@
+/*
+BLAKE2b (RFC 7693), keyed mode, for the short inputs of ESEM.
+AVX2 compression function when the compiler targets it, portable C otherwise.
+*/
+
+#ifndef __BLAKE2B_H__
+#define __BLAKE2B_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+// For C++
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#define BLAKE2B_BLOCKBYTES    128
+#define BLAKE2B_OUTBYTES      64
+#define BLAKE2B_KEYBYTES      64
+
+
+// State of a keyed BLAKE2b after the key block. A key that is used for many short messages is absorbed once,
+// each message then costs a single compression.
+typedef struct {
+    uint64_t h[8];
+    size_t outlen;
+} blake2b_midstate_t;
+
+
+// BLAKE2b of in under key (unkeyed if keylen is 0), outlen bytes of output. Same arguments as libb2's blake2b.
+// Returns 0 on success, -1 if a length is out of range.
+int blake2b(void *out, const void *in, const void *key, size_t outlen, size_t inlen, size_t keylen);
+
+// The fixed shapes used by ESEM, blake2b_<outlen>_<inlen>_<keylen>. Each is one compression of the key block and one of
+// the message block, with the lengths known at compile time.
+void blake2b_16_8_32(unsigned char *out, const unsigned char *in, const unsigned char *key);
+void blake2b_36_16_32(unsigned char *out, const unsigned char *in, const unsigned char *key);
+void blake2b_40_16_32(unsigned char *out, const unsigned char *in, const unsigned char *key);
+void blake2b_32_32_16(unsigned char *out, const unsigned char *in, const unsigned char *key);
+
+// Four independent keyed hashes of the same shape, one per 64-bit lane of the AVX2 registers: out[j] = BLAKE2b(in[j], key[j]),
+// identical to four blake2b calls. Only the short keyed form, 1 <= inlen <= BLAKE2B_BLOCKBYTES and 1 <= keylen <= BLAKE2B_KEYBYTES;
+// returns -1 for other lengths. Lanes may share input and key buffers.
+int blake2b_x4(unsigned char *const out[4], const unsigned char *const in[4], const unsigned char *const key[4], size_t outlen, size_t inlen, size_t keylen);
+void blake2b_36_16_32_x4(unsigned char *const out[4], const unsigned char *const in[4], const unsigned char *const key[4]);
+void blake2b_40_16_32_x4(unsigned char *const out[4], const unsigned char *const in[4], const unsigned char *const key[4]);
+void blake2b_32_32_16_x4(unsigned char *const out[4], const unsigned char *const in[4], const unsigned char *const key[4]);
+
+// Absorbs key (1 to BLAKE2B_KEYBYTES bytes) for hashes of outlen bytes. Returns 0 on success, -1 if a length is out of range.
+int blake2b_midstate_init(blake2b_midstate_t *state, const void *key, size_t outlen, size_t keylen);
+
+// Keyed BLAKE2b of in (1 to BLAKE2B_BLOCKBYTES bytes) resumed from state, same output as blake2b with the state's key.
+// Returns 0 on success, -1 if inlen is out of range.
+int blake2b_midstate_hash(const blake2b_midstate_t *state, void *out, const void *in, size_t inlen);
+
+// Four blake2b_midstate_hash of inlen-byte messages, one per lane; out[j] gets state[j]->outlen bytes.
+int blake2b_midstate_hash_x4(const blake2b_midstate_t *const state[4], unsigned char *const out[4], const unsigned char *const in[4], size_t inlen);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif